@@ -0,0 +1,347 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* Ole Dreessen; ole.dreessen@maximintegrated.com
+* 
+**********************************************************************/
+
+#ifndef Arduino_MAX17055_Coroutine_h 
+#define Arduino_MAX17055_Coroutine_h 
+
+#include <Arduino-MAX17055_Driver.h>
+
+// Optional, needs a C++20 compiler with coroutine support (e.g. ESP-IDF or Linux hosts).
+// On other platforms including this header has no effect.
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+// Number of coroutines that can wait in a MAX17055Co::Executor at the same time, sleep() blocks when
+// more are waiting
+#ifndef MAX17055_CO_SLOTS
+  #define MAX17055_CO_SLOTS 16
+#endif
+
+/**********************************************************************
+* @brief MAX17055Co - Coroutine layer for C++20 hosts. Many gauges can be driven from one
+* thread without blocking: the waits of init() and restoreLearnedParameters() become
+* co_await on an Executor instead of calls of the wait function, so other coroutines run
+* meanwhile. The I2C transfers themselves are still done synchronously by Wire.
+*
+*   MAX17055Co::Executor executor;
+*   MAX17055Co::Task<void> run(MAX17055& gauge)
+*   {
+*     bool ok = co_await MAX17055Co::init(executor, gauge, 3000, 330, 360, MAX17055::Generic, false, 0.01);
+*     MAX17055::Snapshot snap;
+*     while (ok && co_await MAX17055Co::snapshot(executor, gauge, snap)) { ...; co_await executor.sleep(1000); }
+*   }
+*   executor.spawn(run(gauge1)); executor.spawn(run(gauge2)); executor.run();
+*
+* An exception leaving a task is thrown again in the coroutine awaiting it, or for a spawned task
+* from spawn(), runOnce() or run().
+**********************************************************************/
+
+namespace MAX17055Co
+{
+  template<class T> class Task;
+
+  namespace detail
+  {
+    // resumes the awaiting coroutine when a task finishes
+    struct FinalAwaiter
+    {
+      bool await_ready() noexcept { return false; }
+      template<class P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+      {
+        std::coroutine_handle<> next = h.promise().continuation;
+        return next ? next : std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+
+    struct PromiseBase
+    {
+      std::coroutine_handle<> continuation;
+      std::exception_ptr error;
+      std::suspend_always initial_suspend() noexcept { return {}; }
+      FinalAwaiter final_suspend() noexcept { return {}; }
+      void unhandled_exception() { error = std::current_exception(); }
+      void rethrow() { if (error) std::rethrow_exception(error); }
+    };
+  }
+
+  // Lazily started coroutine, co_await it from another coroutine or pass it to Executor::spawn()
+  template<class T>
+  class Task
+  {
+    public:
+      struct promise_type : detail::PromiseBase
+      {
+        T value{};
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_value(T v) { value = std::move(v); }
+      };
+
+      Task(Task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+      ~Task() { if (_handle) _handle.destroy(); }
+
+      bool await_ready() const noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+      {
+        _handle.promise().continuation = awaiting;
+        return _handle;
+      }
+      T await_resume()
+      {
+        _handle.promise().rethrow();
+        return std::move(_handle.promise().value);
+      }
+
+    private:
+      friend class Executor;
+      explicit Task(std::coroutine_handle<promise_type> h) : _handle(h) {}
+      std::coroutine_handle<promise_type> _handle;
+  };
+
+  template<>
+  class Task<void>
+  {
+    public:
+      struct promise_type : detail::PromiseBase
+      {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_void() {}
+      };
+
+      Task(Task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+      ~Task() { if (_handle) _handle.destroy(); }
+
+      bool await_ready() const noexcept { return false; }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+      {
+        _handle.promise().continuation = awaiting;
+        return _handle;
+      }
+      void await_resume() { _handle.promise().rethrow(); }
+
+    private:
+      friend class Executor;
+      explicit Task(std::coroutine_handle<promise_type> h) : _handle(h) {}
+      std::coroutine_handle<promise_type> _handle;
+  };
+
+  // Single threaded scheduler resuming coroutines when their sleep() is over
+  class Executor
+  {
+    public:
+      Executor(void (*wait)(uint32_t) = &delay) : _wait(wait) {}
+      ~Executor()
+      {
+        for (auto& root : _roots)
+          if (root) root.destroy();
+      }
+
+      // starts the task and keeps it until it finished, returns false if all slots are in use
+      bool spawn(Task<void>&& task)
+      {
+        for (auto& root : _roots)
+        {
+          if (root)
+            continue;
+          root = std::exchange(task._handle, nullptr);
+          root.resume();
+          collect();
+          return true;
+        }
+        return false;
+      }
+
+      // awaitable suspending the coroutine for at least ms
+      auto sleep(uint32_t ms)
+      {
+        struct Awaiter
+        {
+          Executor& executor;
+          uint32_t wakeMs;
+          bool await_ready() const noexcept { return false; }
+          bool await_suspend(std::coroutine_handle<> h) noexcept { return executor.park(h, wakeMs); }
+          void await_resume() const noexcept {}
+        };
+        return Awaiter{*this, millis() + ms};
+      }
+
+      // resumes every coroutine whose sleep is over, returns false when no coroutine is left
+      bool runOnce()
+      {
+        uint32_t now = millis();
+        for (auto& slot : _sleeping)
+        {
+          if (!slot.handle || (int32_t) (now - slot.wakeMs) < 0)
+            continue;
+          std::coroutine_handle<> h = std::exchange(slot.handle, nullptr);
+          h.resume();
+        }
+        collect();
+        for (auto& root : _roots)
+          if (root) return true;
+        return false;
+      }
+
+      // runs until all spawned tasks finished, waiting with the wait function while nothing is due
+      void run()
+      {
+        while (runOnce())
+        {
+          uint32_t now = millis();
+          int32_t idle = (int32_t) (nextWakeMs() - now);
+          if (idle > 0)
+            _wait(idle);
+        }
+      }
+
+      // millis() at which the next coroutine wakes up
+      uint32_t nextWakeMs() const
+      {
+        uint32_t now = millis();
+        uint32_t next = now + 0x7FFFFFFF;
+        for (const auto& slot : _sleeping)
+          if (slot.handle && (int32_t) (slot.wakeMs - next) < 0)
+            next = slot.wakeMs;
+        return next;
+      }
+
+    private:
+      struct Sleeping
+      {
+        std::coroutine_handle<> handle;
+        uint32_t wakeMs;
+      };
+      Sleeping _sleeping[MAX17055_CO_SLOTS] = {};
+      std::coroutine_handle<Task<void>::promise_type> _roots[MAX17055_CO_SLOTS] = {};
+      void (*_wait)(uint32_t);
+
+      bool park(std::coroutine_handle<> h, uint32_t wakeMs)
+      {
+        for (auto& slot : _sleeping)
+        {
+          if (slot.handle)
+            continue;
+          slot.handle = h;
+          slot.wakeMs = wakeMs;
+          return true;
+        }
+        // no free slot, the sleep still has to last, e.g. the waits of the gauge sequences.
+        // Block for it, the other coroutines wait meanwhile
+        int32_t idle = (int32_t) (wakeMs - millis());
+        if (idle > 0)
+          _wait(idle);
+        return false;
+      }
+
+      void collect()
+      {
+        for (auto& root : _roots)
+        {
+          if (root && root.done())
+          {
+            std::exception_ptr error = root.promise().error;
+            root.destroy();
+            root = nullptr;
+            if (error)
+              std::rethrow_exception(error);
+          }
+        }
+      }
+  };
+
+  // MAX17055::init() without blocking, the result of MAX17055::initPOR() tells if the gauge was configured
+  inline Task<bool> init(Executor& executor, MAX17055& gauge, MAX17055::Config config, TwoWire *theWire = &Wire)
+  {
+    if (!gauge.beginInit(config, theWire))
+      co_return false;
+
+    // including the settings check after a warm boot, like MAX17055::init()
+    uint32_t waitMs;
+    MAX17055::jobStatus status;
+    while ((status = gauge.runJob(waitMs)) == MAX17055::JobPending || (status == MAX17055::JobDone && gauge.jobPending()))
+    {
+      if (status == MAX17055::JobPending)
+        co_await executor.sleep(waitMs);
+    }
+    co_return status == MAX17055::JobDone;
+  }
+
+  inline Task<bool> init(Executor& executor, MAX17055& gauge, uint16_t batteryCapacity, uint16_t vEmpty, uint16_t vRecovery,
+                         uint8_t modelID, bool vCharge, float resistSensor, TwoWire *theWire = &Wire)
+  {
+    MAX17055::Config config = MAX17055::Config().resistSensor(resistSensor).capacity(batteryCapacity)
+                                                .emptyVoltage(vEmpty, vRecovery).model(modelID, vCharge);
+    return init(executor, gauge, config, theWire);
+  }
+
+  // MAX17055::restoreLearnedParameters() without blocking for its 700ms of waits
+  inline Task<void> restoreLearnedParameters(Executor& executor, MAX17055& gauge, uint16_t rComp0, uint16_t tempCo,
+                                             uint16_t fullCapRep, uint16_t cycles, uint16_t fullCapNom)
+  {
+    gauge.beginRestoreLearnedParameters(rComp0, tempCo, fullCapRep, cycles, fullCapNom);
+    uint32_t waitMs;
+    while (gauge.runJob(waitMs) == MAX17055::JobPending)
+      co_await executor.sleep(waitMs);
+  }
+
+  // same for a stored record, false if the record was refused
+  inline Task<bool> restoreLearnedParameters(Executor& executor, MAX17055& gauge, MAX17055::LearnedParams params)
+  {
+    if (!gauge.beginRestoreLearnedParameters(params))
+      co_return false;
+    uint32_t waitMs;
+    MAX17055::jobStatus status;
+    while ((status = gauge.runJob(waitMs)) == MAX17055::JobPending)
+      co_await executor.sleep(waitMs);
+    co_return status == MAX17055::JobDone;
+  }
+
+  // MAX17055::readSnapshot() scheduled just after the next ADC update once the phase is locked
+  inline Task<bool> snapshot(Executor& executor, MAX17055& gauge, MAX17055::Snapshot& snap)
+  {
+    if (gauge.adcPhase().locked())
+    {
+      uint32_t now = micros();
+      uint32_t waitMs = (gauge.adcPhase().nextConversion(now) - now + 999) / 1000;
+      if (waitMs > 0)
+        co_await executor.sleep(waitMs);
+    }
+    co_return gauge.readSnapshot(snap);
+  }
+}
+
+#endif
+#endif
+
+#endif
@@ -56,82 +56,73 @@
 **********************************************************************/
 
 
-// Constructors 
-MAX17055::MAX17055(void)
-  
+// Public Methods
+bool MAX17055::begin(bool& por, TwoWire *theWire, void (*wait)(uint32_t))
 {
-	//doesn't need anything here
+    Config config = _config;
+    return init(config, por, theWire, wait);
 }
 
-MAX17055::MAX17055(uint16_t batteryCapacity)
+bool MAX17055::begin(TwoWire *theWire)
 {
-	//calcuation based on AN6358 page 13 figure 1.3 for Capacity, but reversed to get the register value 
-	writeReg16Bit(DesignCap, batteryCapacity*2);
+    bool por;
+    return begin(por, theWire);
 }
 
-// Public Methods
 bool MAX17055::init(uint16_t batteryCapacity, uint16_t vEmpty, uint16_t vRecovery, uint8_t modelID, bool vCharge, 
               float resistSensor, bool& por, TwoWire *theWire, void (*wait)(uint32_t)) 
 {
-    _wire = theWire;
-    _wait = wait;
+    Config config = Config().resistSensor(resistSensor).capacity(batteryCapacity)
+                            .emptyVoltage(vEmpty, vRecovery).model(modelID, vCharge);
+    return init(config, por, theWire, wait);
+}
 
-    _wire->beginTransmission(I2CAddress);
-    byte error = _wire->endTransmission();
-    if (error == 0) //Device Acknowledged
+bool MAX17055::init(const Config& config, bool& por, TwoWire *theWire, void (*wait)(uint32_t))
+{
+    MAX17055_PROFILE_BEGIN(OpInit, 0);
+    _wait = wait;
+    por = false;
+    if (!beginInit(config, theWire))
     {
-        setResistSensor(resistSensor);
-
-        // see MAX17055 Software Implementation Guide
-        // 1.
-        por = getPOR();
-        
-        // additionally check if design capacity or other important settings changed
-        // it can happen the chip loses its settings for some reason without triggering POR
-        // this is a workaround to prevent that
-        bool capacityMatches = abs(getDesignCapacity() - batteryCapacity) < 10;
-        bool voltageMatches = getEmptyVoltage() == vEmpty;
-        bool chemistryMatches = (getModelCfg() & 0x00F0) == ((uint16_t) modelID & 0x00F0);
-
-        if (!capacityMatches || !voltageMatches || !chemistryMatches) {
-            // ignore hardware POR if settings changed
-            por = true;
-        }
-        
-        if (por)
-        {
-            // 2. do not continue until FSTAT.DNR == 0
-            while(readReg16Bit(FStat)&1) {
-                _wait(10);
-            }
+        MAX17055_PROFILE_END(OpInit, 0);
+        return false; //device not found or invalid config
+    }
 
-            // 3. Initialize configuration
-            uint16_t hibCfg = readReg16Bit(HibCfg);
-            writeReg16Bit(CommandReg, 0x90);
-            writeReg16Bit(HibCfg, 0x0);
-            writeReg16Bit(CommandReg, 0x0);
+    jobStatus status = finishJob();
+    // a warm boot left the check of the other settings, finish it before returning
+    if (status == JobDone && _job == jobVerify)
+        status = finishJob();
+    por = _jobPOR;
+    MAX17055_PROFILE_END(OpInit, 0);
+    return status == JobDone;
+}
 
-            // 3.1 OPTION 1 EZ Config (no INI file is needed): 
-            setDesignCapacity(batteryCapacity);
-            writeReg16Bit(DQAcc, batteryCapacity / 16);
-            // writeReg16Bit(IchgTerm, 0x640); // leave default for now
-            setEmptyVoltage(vEmpty, vRecovery);
+bool MAX17055::beginInit(uint16_t batteryCapacity, uint16_t vEmpty, uint16_t vRecovery, uint8_t modelID, bool vCharge, 
+              float resistSensor, TwoWire *theWire)
+{
+    Config config = Config().resistSensor(resistSensor).capacity(batteryCapacity)
+                            .emptyVoltage(vEmpty, vRecovery).model(modelID, vCharge);
+    return beginInit(config, theWire);
+}
 
-            // leave out dQAcc for now
-            setModelCfg(vCharge, modelID);
+bool MAX17055::beginInit(const Config& config, TwoWire *theWire)
+{
+    _wire = theWire;
+    // abandons a pending settings check too, the new init checks the settings again
+    _job = jobNone;
+    _nextJob = jobNone;
+    if (!config.valid() || !_traits->ezConfig)
+        return false;
 
-            // Do not continue until ModelCFG.Refresh == 0
-            while (readReg16Bit(ModelCfg) & 0x8000) {
-                _wait(10);
-            }
-            writeReg16Bit(HibCfg, hibCfg); // Restore Original HibCFG value 
+    // the Status read doubles as the probe, it's the first of the two reads of a warm boot
+    if (readRegs(Status, &_jobData[5], 1) == 0)
+        return false; //device not found
 
-            // 4. clear POR bit
-            resetPOR();
-        }
-        return true;
-    }
-    return false; //device not found
+    setResistSensor(config.resistSensor());
+    _config = config;
+    _jobPOR = false;
+    startJob(jobInit);
+    return true;
 }
 
 void MAX17055::getLearnedParameters(uint16_t& rComp0, uint16_t& tempCo, uint16_t& fullCapRep, uint16_t& cycles, uint16_t& fullCapNom) 
@@ -145,24 +136,155 @@ void MAX17055::getLearnedParameters(uint16_t& rComp0, uint16_t& tempCo, uint16_t
 
 void MAX17055::restoreLearnedParameters(uint16_t rComp0, uint16_t tempCo, uint16_t fullCapRep, uint16_t cycles, uint16_t fullCapNom)
 {
-    writeReg16Bit(RComp0, rComp0);
-    writeReg16Bit(TempCo, tempCo);
-    writeReg16Bit(FullCapNom, fullCapNom);
+    MAX17055_PROFILE_BEGIN(OpRestore, 0);
+    beginRestoreLearnedParameters(rComp0, tempCo, fullCapRep, cycles, fullCapNom);
+    finishJob();
+    MAX17055_PROFILE_END(OpRestore, 0);
+}
+
+bool MAX17055::getLearnedParameters(LearnedParams& params, uint32_t timestamp)
+{
+    ReadPlan<RComp0, TempCo, FullCapRep, Cycles, FullCapNom> plan;
+    uint16_t raw[plan.size];
+    if (!read(plan, raw))
+        return false;
+
+    params.version    = learnedParamsVersion;
+    params.rComp0     = raw[0];
+    params.tempCo     = raw[1];
+    params.fullCapRep = raw[2];
+    params.cycles     = raw[3];
+    params.fullCapNom = raw[4];
+    params.config     = _config.fingerprint();
+    params.timestamp  = timestamp;
+    params.crc        = crc16((const uint8_t*) &params, sizeof(LearnedParams) - sizeof(params.crc));
+    return true;
+}
+
+bool MAX17055::checkLearnedParameters(const LearnedParams& params) const
+{
+    return params.version == learnedParamsVersion &&
+           params.crc == crc16((const uint8_t*) &params, sizeof(LearnedParams) - sizeof(params.crc)) &&
+           params.config == _config.fingerprint();
+}
+
+bool MAX17055::restoreLearnedParameters(const LearnedParams& params)
+{
+    MAX17055_PROFILE_BEGIN(OpRestore, 0);
+    bool success = beginRestoreLearnedParameters(params) && finishJob() == JobDone;
+    MAX17055_PROFILE_END(OpRestore, 0);
+    return success;
+}
+
+bool MAX17055::beginRestoreLearnedParameters(const LearnedParams& params)
+{
+    if (!checkLearnedParameters(params))
+        return false;
+    beginRestoreLearnedParameters(params.rComp0, params.tempCo, params.fullCapRep, params.cycles, params.fullCapNom);
+    return true;
+}
+
+void MAX17055::beginRestoreLearnedParameters(uint16_t rComp0, uint16_t tempCo, uint16_t fullCapRep, uint16_t cycles, uint16_t fullCapNom)
+{
+    _jobData[0] = rComp0;
+    _jobData[1] = tempCo;
+    _jobData[2] = fullCapRep;
+    _jobData[3] = cycles;
+    _jobData[4] = fullCapNom;
+    startJob(jobRestore);
+}
+
+MAX17055::jobStatus MAX17055::runJob(uint32_t& waitMs)
+{
+    MAX17055_PROFILE_BEGIN(OpJob, _job);
+#if MAX17055_PROFILE
+    uint8_t job = _job;
+#endif
+    waitMs = 0;
+    jobStatus status = JobDone;
+    switch (_job)
+    {
+        case jobInit:    status = initStep(waitMs);    break;
+        case jobRestore: status = restoreStep(waitMs); break;
+        case jobVerify:  status = verifyStep(waitMs);  break;
+    }
+    MAX17055_PROFILE_END(OpJob, job);
+    return status;
+}
+
+uint16_t MAX17055::setShutdownTimeout(uint16_t seconds)
+{
+    // timeout is 175.8ms * 2^(8+THR), that's 45s * 2^THR
+    uint8_t thr = 0;
+    while (thr < 7 && (45u << thr) < seconds)
+        thr++;
+    writeReg16Bit(ShdnTimer, (uint16_t) thr << 13);
+    return 45u << thr;
+}
+
+bool MAX17055::shutdown()
+{
+    // leave hibernate first, the shutdown timer runs slower there. Nothing is written if a read fails,
+    // the zeros of a failed read would clear Config and lose HibCfg
+    uint16_t hibCfg, config;
+    if (readRegs(HibCfg, &hibCfg, 1) == 0 || readRegs(ConfigReg, &config, 1) == 0)
+        return false;
+    _hibCfg = hibCfg;
+    WriteBatch batch;
+    batch.add(HibCfg, 0x0);
+    batch.barrier();
+    batch.add(ConfigReg, config | 0x0080); // SHDN
+    return writeBatch(batch);
+}
+
+bool MAX17055::wake(bool& por)
+{
+    // the first transactions wake the gauge, it may not acknowledge them
+    uint8_t probes = 0;
+    while (!probe())
+    {
+        if (++probes >= wakeProbes)
+            return false;
+        _wait(1);
+    }
+
+    if (!init(_config, por, _wire, _wait))
+        return false;
+    // HibCfg keeps the 0 of shutdown() unless the gauge reset, also when init() configured it again
+    // without a reset. An MCU reset loses the saved value, the gauge then gets the default back
+    uint16_t hibCfg;
+    if (readRegs(HibCfg, &hibCfg, 1) == 0)
+        return false;
+    if (hibCfg == 0)
+        writeReg16Bit(HibCfg, _hibCfg != 0 ? _hibCfg : hibCfgDefault);
+    _hibCfg = 0;
+    return true;
+}
+
+void MAX17055::setVoltageAlert(uint16_t minMv, uint16_t maxMv)
+{
+    writeReg16Bit(VAlrtTh, ((maxMv / 20) << 8) | ((minMv / 20) & 0xFF));
+}
 
-    _wait(350);
-    
-    uint16_t mixCap = (readReg16Bit(MixSOC)*readReg16Bit(FullCapNom))/25600;
-    writeReg16Bit(MixCap, mixCap);
-    writeReg16Bit(FullCapRep, fullCapRep);
+void MAX17055::setSOCAlert(uint8_t minPercent, uint8_t maxPercent)
+{
+    writeReg16Bit(SAlrtTh, ((uint16_t) maxPercent << 8) | minPercent);
+}
 
-    //Write dQacc to 200% of Capacity and dPacc to 200%  
-    uint16_t dQAcc = (FullCapNom / 16);
-    writeReg16Bit(DPAcc, 0x0C80);
-    writeReg16Bit(DQAcc, dQAcc); 
+void MAX17055::enableAlerts(bool enable)
+{
+    uint16_t config = readReg16Bit(ConfigReg);
+    writeReg16Bit(ConfigReg, enable ? config | 0x0004 : config & ~0x0004); // Aen
+}
 
-    _wait(350);
+uint16_t MAX17055::getAlerts()
+{
+    return readReg16Bit(Status) & alertAll;
+}
 
-    writeReg16Bit(Cycles, cycles);
+void MAX17055::clearAlerts()
+{
+    writeReg16Bit(Status, readReg16Bit(Status) & ~alertAll);
 }
 
 bool MAX17055::getPOR() 
@@ -176,12 +298,7 @@ void MAX17055::resetPOR()
 }
 
 void MAX17055::setEmptyVoltage(uint16_t vEmpty, uint16_t vRecovery){
-    uint16_t regVal = (vEmpty << 7) & 0xFF80;
-
-    // vRecovery has a resolution of 40mV in the Reg
-    regVal = regVal | ((vRecovery >> 2) & 0x007F);
-
-	writeReg16Bit(VEmpty, regVal);
+	writeReg16Bit(VEmpty, emptyVoltageReg(vEmpty, vRecovery));
 }
 
 uint16_t MAX17055::getEmptyVoltage(){
@@ -189,13 +306,7 @@ uint16_t MAX17055::getEmptyVoltage(){
 }
 
 void MAX17055::setModelCfg(bool vChg, uint8_t modelID) {
-  uint16_t val = 0x8000;
-  if(vChg) {
-    val = val | 0x400;
-  }
-  val = val | (modelID & 0xF0);
-
-  writeReg16Bit(ModelCfg, val);
+  writeReg16Bit(ModelCfg, modelCfgReg(vChg, modelID));
 }
 
 uint16_t MAX17055::getModelCfg(){
@@ -305,8 +416,8 @@ float MAX17055::getTimeToEmpty()
 }
 
 float MAX17055::getTemperature() {
-    uint16_t temp_raw= readReg16Bit(Temperature);
-    return temp_raw * percentage_multiplier;
+    int16_t temp_raw= readReg16Bit(Temperature); // two's complement, below 0 degC is negative
+    return toTemperature(temp_raw);
 }
 
 float MAX17055::getAge() {
@@ -319,27 +430,730 @@ bool MAX17055::getPresent() { //TODO: Doesn't seem to detect battery removal/re-
     return !pres_raw; //hence we invert to return true if battery is present
 }
 
+bool MAX17055::writeBatch(WriteBatch& batch)
+{
+    MAX17055_PROFILE_BEGIN(OpBatch, 0);
+    // sort by stage, then address. Batches are small, insertion sort is enough
+    for (uint8_t i = 1; i < batch._count; i++)
+    {
+        WriteBatch::entry e = batch._entries[i];
+        uint8_t j = i;
+        while (j > 0 && (batch._entries[j-1].stage > e.stage ||
+               (batch._entries[j-1].stage == e.stage && batch._entries[j-1].reg > e.reg)))
+        {
+            batch._entries[j] = batch._entries[j-1];
+            j--;
+        }
+        batch._entries[j] = e;
+    }
+
+    // stage by stage, so with verification a stage is complete before the next one is written and
+    // ModelCfg only starts the refresh once everything before it is correct
+    bool success = true;
+    beginBurst();
+    for (uint8_t first = 0, end = 0; first < batch._count; first = end)
+    {
+        while (end < batch._count && batch._entries[end].stage == batch._entries[first].stage)
+            end++;
+
+        for (uint8_t i = first; i < end; i += batchRun(batch, i))
+        {
+            uint8_t n = batchRun(batch, i);
+            MAX17055_PROFILE_BEGIN(OpWrite, batch._entries[i].reg);
+            beginWrite(batch._entries[i].reg);
+            for (uint8_t k = i; k < i + n; k++)
+                writeWord(batch._entries[k].value);
+            uint8_t status = WriteSent;
+            if (!endWrite())
+            {
+                status = WriteFailed;
+                success = false;
+            }
+            MAX17055_PROFILE_END(OpWrite, batch._entries[i].reg);
+            for (uint8_t k = i; k < i + n; k++)
+                batch._entries[k].status = status;
+        }
+        if (verifyWrites)
+            verifyStage(batch, first, end);
+    }
+    endBurst();
+    MAX17055_PROFILE_END(OpBatch, 0);
+    return verifyWrites ? batch.failures() == 0 : success;
+}
+
+void MAX17055::verifyStage(WriteBatch& batch, uint8_t first, uint8_t end)
+{
+    // read back the bursts of the stage, then retry single mismatching registers
+    for (uint8_t i = first; i < end; i += batchRun(batch, i))
+    {
+        uint8_t n = batchRun(batch, i);
+        bool readable = false;
+        for (uint8_t k = i; k < i + n; k++)
+            readable = readable || verifyMask(batch._entries[k].reg) != 0;
+        if (!readable)
+            continue;
+
+        uint16_t readback[burstWriteRegs];
+        bool read = readRegs(batch._entries[i].reg, readback, n) != 0;
+
+        for (uint8_t k = 0; k < n; k++)
+        {
+            WriteBatch::entry& e = batch._entries[i + k];
+            uint16_t mask = verifyMask(e.reg);
+            if (mask == 0)
+                continue;
+            if (read && ((readback[k] ^ e.value) & mask) == 0 && e.status != WriteFailed)
+            {
+                e.status = WriteVerified;
+                continue;
+            }
+
+            e.status = WriteFailed;
+            for (uint8_t attempt = 0; attempt < verifyRetries; attempt++)
+            {
+                _health.retries++;
+                writeReg16Bit(e.reg, e.value);
+                uint16_t value;
+                if (readRegs(e.reg, &value, 1) != 0 && ((value ^ e.value) & mask) == 0)
+                {
+                    e.status = WriteRetried;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void MAX17055::setWriteVerify(bool enable, uint8_t retries)
+{
+    verifyWrites = enable;
+    verifyRetries = retries;
+}
+
+uint8_t MAX17055::WriteBatch::failures() const
+{
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        if (_entries[i].status == WriteFailed)
+            n++;
+    }
+    return n;
+}
+
+bool MAX17055::readSnapshot(Snapshot& snap)
+{
+    MAX17055_PROFILE_BEGIN(OpSnapshot, 0);
+    uint16_t a[snapshotCountA];
+    uint16_t b[snapshotCountB];
+    beginBurst();
+    bool success = readRegs(snapshotFirstA, a, snapshotCountA) != 0 && readRegs(snapshotFirstB, b, snapshotCountB) != 0;
+    endBurst();
+    if (!success)
+    {
+        MAX17055_PROFILE_END(OpSnapshot, 0);
+        return false;
+    }
+
+    snap.status      = a[Status - snapshotFirstA];
+    snap.repCap      = a[RepCap - snapshotFirstA];
+    snap.repSOC      = a[RepSOC - snapshotFirstA];
+    snap.age         = a[Age - snapshotFirstA];
+    snap.temperature = a[Temperature - snapshotFirstA];
+    snap.vCell       = a[VCell - snapshotFirstA];
+    snap.current     = a[Current - snapshotFirstA];
+    snap.avgCurrent  = a[AvgCurrent - snapshotFirstA];
+    snap.fullCapRep  = b[FullCapRep - snapshotFirstB];
+    snap.timeToEmpty = b[TimeToEmpty - snapshotFirstB];
+    snap.cycles      = b[Cycles - snapshotFirstB];
+    snap.avgVCell    = b[AvgVCell - snapshotFirstB];
+    snap.micros      = micros();
+    if (consistencyCheck && !checkConsistency(snap))
+    {
+        MAX17055_PROFILE_END(OpSnapshot, 0);
+        return false;
+    }
+
+    _adcPhase.observe(snap.current, snap.micros);
+    MAX17055_PROFILE_END(OpSnapshot, 0);
+    return true;
+}
+
+bool MAX17055::readSnapshot(Snapshot& snap, BusHealth& health)
+{
+    bool success = readSnapshot(snap);
+    health = _health;
+    return success;
+}
+
+bool MAX17055::checkConsistency(Snapshot& snap)
+{
+    float socLimit = 65535.0f;
+    if (_guardValid)
+    {
+        // the most the charge can have changed since the last snapshot, in RepSOC LSBs (1/256%)
+        // Current LSB is 1.5625uV/Rsense and capacity LSB 5uVh/Rsense, so the charge is current * 0.3125 * hours
+        float current = max(fabs((float) snap.current), fabs((float) snap.avgCurrent));
+        float hours = (snap.micros - _guardMicros) / 3.6e9f;
+        if (snap.fullCapRep)
+            socLimit = socJumpMargin + 25600.0f * current * 0.3125f * hours / snap.fullCapRep;
+    }
+    bool read = true;
+    bool socOk = recheck(RepSOC, snap.repSOC, socLimit, read);
+    bool vCellOk = recheck(VCell, snap.vCell, vCellJumpLimit, read);
+
+    // only accepted values are the reference for the next check
+    if (socOk && vCellOk)
+    {
+        _guardSOC = snap.repSOC;
+        _guardVCell = snap.vCell;
+        _guardMicros = snap.micros;
+        _guardValid = true;
+    }
+    return read;
+}
+
+bool MAX17055::plausible(uint8_t reg, uint16_t value, float limit) const
+{
+    // all ones is a bus without a device driving it, a cell voltage of 0 a transfer that got lost
+    if (value == 0xFFFF || (reg == VCell && value == 0))
+        return false;
+    if (!_guardValid)
+        return true;
+    uint16_t last = reg == VCell ? _guardVCell : _guardSOC;
+    uint16_t diff = value > last ? value - last : last - value;
+    return diff <= limit;
+}
+
+bool MAX17055::recheck(uint8_t reg, uint16_t& value, float limit, bool& read)
+{
+    // returns true if value is accepted, read turns false if the re-read fails
+    if (plausible(reg, value, limit))
+        return true;
+    _consistency.suspicious++;
+
+    uint16_t again;
+    if (readRegs(reg, &again, 1) == 0)
+    {
+        _consistency.unresolved++;
+        read = false;
+        return false;
+    }
+    // the same jump twice is what the gauge reports, e.g. after it was reset, and is kept
+    if (again == value && plausible(reg, value, 65535.0f))
+        return true;
+    if (again == value || !plausible(reg, again, limit))
+    {
+        _consistency.unresolved++;
+        return false;
+    }
+    _consistency.corrected++;
+    value = again;
+    return true;
+}
+
+MAX17055::SampleStats MAX17055::sampleCurrent(uint8_t n, float* buffer)
+{
+    SampleStats result;
+    memset(&result, 0, sizeof(result));
+    float m2Current = 0, m2Voltage = 0;
+
+    uint16_t last[2] = {0, 0};
+    uint32_t lastMicros = 0;
+    uint32_t target = micros();
+    // bounds the loop if the gauge stops updating, e.g. in shutdown
+    uint16_t reads = maxSampleReads(n);
+
+    while (result.count < n && reads-- > 0)
+    {
+        uint32_t now = micros();
+        if ((int32_t) (target - now) > 0)
+            _wait((target - now + 999) / 1000);
+
+        uint16_t raw[2]; // VCell, Current
+        if (readRegs(VCell, raw, 2) == 0)
+            break;
+        uint32_t t = micros();
+        _adcPhase.observe(raw[1], t);
+
+        // read again just after the next update, or where it helps locking the phase
+        target = _adcPhase.nextRead(t + 1);
+
+        // a new sample needs a changed value, or an update between the reads known from the phase
+        // or from a whole ADC cycle having passed. With the phase, the whole window of the first update
+        // after the last sample has to lie between the reads
+        if (result.count > 0)
+        {
+            bool changed = raw[0] != last[0] || raw[1] != last[1];
+            bool updated = t - lastMicros > AdcPhase::periodMicros + AdcPhase::guardMicros ||
+                           (_adcPhase.locked() && (int32_t) (t - _adcPhase.updateAfter(lastMicros)) >= 0);
+            if (!changed && !updated)
+            {
+                result.duplicates++;
+                continue;
+            }
+        }
+        last[0] = raw[0];
+        last[1] = raw[1];
+        lastMicros = t;
+
+        float current = toCurrent(raw[1]);
+        float voltage = toVoltage(raw[0]);
+        if (buffer != NULL)
+            buffer[result.count] = current;
+
+        // Welford's online algorithm
+        result.count++;
+        if (result.count == 1)
+        {
+            result.current.min = result.current.max = current;
+            result.voltage.min = result.voltage.max = voltage;
+        }
+        float delta = current - result.current.mean;
+        result.current.mean += delta / result.count;
+        m2Current += delta * (current - result.current.mean);
+        result.current.min = min(result.current.min, current);
+        result.current.max = max(result.current.max, current);
+
+        delta = voltage - result.voltage.mean;
+        result.voltage.mean += delta / result.count;
+        m2Voltage += delta * (voltage - result.voltage.mean);
+        result.voltage.min = min(result.voltage.min, voltage);
+        result.voltage.max = max(result.voltage.max, voltage);
+    }
+
+    if (result.count > 1)
+    {
+        result.current.variance = m2Current / (result.count - 1);
+        result.voltage.variance = m2Voltage / (result.count - 1);
+    }
+    return result;
+}
+
+bool MAX17055::readSocSet(SocSet& socs)
+{
+    ReadPlan<VFSOC, AvSOC, MixSOC, RepSOC, AvCap, MixCap, RepCap, FullCapRep> plan;
+    uint16_t raw[plan.size];
+    if (!read(plan, raw))
+        return false;
+
+    socs.vfSOC      = toPercentage(raw[0]);
+    socs.avSOC      = toPercentage(raw[1]);
+    socs.mixSOC     = toPercentage(raw[2]);
+    socs.repSOC     = toPercentage(raw[3]);
+    socs.avCap      = toCapacity(raw[4]);
+    socs.mixCap     = toCapacity(raw[5]);
+    socs.repCap     = toCapacity(raw[6]);
+    socs.fullCapRep = toCapacity(raw[7]);
+    return true;
+}
+
+float MAX17055::toCapacity(uint16_t raw)
+{
+    return raw * capacity_multiplier_mAH;
+}
+
+float MAX17055::toCurrent(int16_t raw)
+{
+    return raw * current_multiplier_mV;
+}
+
+float MAX17055::toVoltage(uint16_t raw)
+{
+    return raw * voltage_multiplier_V;
+}
+
+float MAX17055::toPercentage(uint16_t raw)
+{
+    return raw * percentage_multiplier;
+}
+
+float MAX17055::toTemperature(int16_t raw)
+{
+    return raw * percentage_multiplier;
+}
+
+float MAX17055::toHours(uint16_t raw)
+{
+    return raw * time_multiplier_Hours;
+}
+
+void MAX17055::AdcPhase::observe(int16_t current, uint32_t micros)
+{
+    uint32_t last = _lastMicros;
+    bool changed = _hasLast && current != _lastCurrent;
+    _lastMicros = micros;
+    _lastCurrent = current;
+    _hasLast = true;
+
+    // without a change, or with a whole cycle in between, the update can't be located
+    if (!changed || micros - last > periodMicros)
+        return;
+
+    if (_valid)
+    {
+        // move the known window forward by whole cycles, to the first one ending after the last read
+        uint32_t edge = _edge + ((last - _edge + periodMicros - 1) / periodMicros) * periodMicros;
+        if ((int32_t) (edge - _window - micros) <= 0)
+        {
+            uint32_t from = (int32_t) (edge - _window - last) > 0 ? edge - _window : last;
+            uint32_t to   = (int32_t) (edge - micros) < 0 ? edge : micros;
+            _edge = to;
+            _window = to - from;
+            return;
+        }
+        // no overlap, the gauge clock drifted or a read was delayed. Start over
+    }
+    _edge = micros;
+    _window = micros - last;
+    _valid = true;
+}
+
+uint32_t MAX17055::AdcPhase::nextConversion(uint32_t now) const
+{
+    if (!_valid)
+        return now;
+
+    uint32_t earliest = now - guardMicros;
+    if ((int32_t) (_edge - earliest) >= 0)
+        return _edge + guardMicros;
+    return _edge + ((earliest - _edge + periodMicros - 1) / periodMicros) * periodMicros + guardMicros;
+}
+
+uint32_t MAX17055::AdcPhase::updateAfter(uint32_t micros) const
+{
+    // the update of every cycle happens within _window before _edge + k cycles, find the first
+    // cycle whose window starts after micros
+    int32_t since = (int32_t) (micros - (_edge - _window));
+    int32_t cycles = since >= 0 ? since / (int32_t) periodMicros + 1 : -((-since - 1) / (int32_t) periodMicros);
+    return _edge + (uint32_t) cycles * periodMicros;
+}
+
+uint32_t MAX17055::AdcPhase::nextRead(uint32_t now) const
+{
+    if (!_valid)
+        return now + periodMicros / 4;
+
+    uint32_t end = nextConversion(now);
+    if (locked())
+        return end;
+
+    uint32_t middle = end - guardMicros - _window / 2;
+    return (int32_t) (middle - now) >= 0 ? middle : end;
+}
+
+int32_t MAX17055::NoiseFilter::update(int32_t raw)
+{
+    int32_t x = raw * (1 << fracBits);
+    if (!_primed)
+    {
+        _value = x;
+        _deviation = 0;
+        _shift = minShift;
+        _primed = true;
+        return raw;
+    }
+
+    int32_t error = x - _value;
+    int32_t absError = error < 0 ? -error : error;
+    int32_t stepLimit = (_deviation << 2) + noiseFloor;
+    if (absError > stepLimit)
+        _shift = minShift; // step in the load, follow it quickly
+    else if (absError <= (_deviation << 1) + noiseFloor && _shift < maxShift)
+        _shift++;          // within the noise, average more
+
+    // shift the magnitude, right shifts of negative values are implementation defined
+    _value += error < 0 ? -(absError >> _shift) : (absError >> _shift);
+    // steps don't count as noise. Divided, not shifted, because the difference is negative while the
+    // deviation shrinks. The compiler turns it into a shift and a sign correction
+    _deviation += ((absError > stepLimit ? stepLimit : absError) - _deviation) / 16;
+    return value();
+}
+
+void MAX17055::TtePredictor::update(int16_t current, uint16_t repCap, uint32_t micros)
+{
+    _repCap = repCap;
+    if (_samples == 0)
+    {
+        _mean = current;
+        _variance = 0;
+        _weightSq = 1;
+        _elapsed = 0;
+        _lastMicros = micros;
+        _samples = 1;
+        return;
+    }
+
+    // weight of the new sample by the time it represents, gaps longer than the time constant count as one
+    float dt = (micros - _lastMicros) * 1e-6f;
+    _lastMicros = micros;
+    if (dt <= 0)
+        return;
+    if (dt > _tau)
+        dt = _tau;
+    float alpha = dt / (_elapsed + dt);
+    _elapsed = min(_elapsed + dt, _tau);
+
+    float delta = current - _mean;
+    _mean += alpha * delta;
+    _variance = (1 - alpha) * (_variance + alpha * delta * delta);
+    _weightSq = (1 - alpha) * (1 - alpha) * _weightSq + alpha * alpha;
+    if (_samples < 255)
+        _samples++;
+}
+
+MAX17055::TteEstimate MAX17055::TtePredictor::estimate() const
+{
+    TteEstimate tte;
+    tte.valid = _samples >= 2 && _mean < 0;
+    if (!tte.valid)
+    {
+        tte.hours = tte.hoursMin = tte.hoursMax = 0;
+        return tte;
+    }
+
+    // RepCap LSB is 5uVh/Rsense, Current LSB 1.5625uV/Rsense
+    const float hoursPerRaw = 5.0 / 1.5625;
+    float deviation = 2 * sqrt(_variance * _weightSq);
+    tte.hours = _repCap * hoursPerRaw / -_mean;
+    tte.hoursMin = _repCap * hoursPerRaw / (deviation - _mean);
+    tte.hoursMax = _mean + deviation < 0 ? _repCap * hoursPerRaw / -(_mean + deviation) : INFINITY;
+    return tte;
+}
+
+bool MAX17055::WriteBatch::add(uint8_t reg, uint16_t value)
+{
+    // writing ModelCfg triggers a refresh with the values written so far, so it always goes last
+    uint8_t stage = (reg == ModelCfg) ? 0xFF : _stage;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        if (_entries[i].reg == reg && _entries[i].stage == stage)
+        {
+            _entries[i].value = value;
+            return true;
+        }
+    }
+    if (_count >= maxWrites)
+        return false;
+
+    _entries[_count].reg = reg;
+    _entries[_count].stage = stage;
+    _entries[_count].value = value;
+    _entries[_count].status = WriteSent;
+    _count++;
+    return true;
+}
+
+void MAX17055::WriteBatch::barrier()
+{
+    if (_stage < 0xFE)
+        _stage++;
+}
+
+void MAX17055::WriteBatch::clear()
+{
+    _count = 0;
+    _stage = 0;
+}
+
 // Private Methods
 
-void MAX17055::writeReg16Bit(uint8_t reg, uint16_t value)
+MAX17055::jobStatus MAX17055::initStep(uint32_t& waitMs)
 {
-  //Write order is LSB first, and then MSB. Refer to AN635 pg 35 figure 1.12.2.5
-  _wire->beginTransmission(I2CAddress);
-  _wire->write(reg);
-  _wire->write( value       & 0xFF); // value low byte
-  _wire->write((value >> 8) & 0xFF); // value high byte
-  _wire->endTransmission();
+    switch (_jobStep)
+    {
+        case 0:
+        {
+            // see MAX17055 Software Implementation Guide
+            // 1. warm boot: without POR and with our DesignCap the gauge most likely kept its
+            // configuration. The remaining settings are checked by the next runJob(), see verifyStep()
+            _jobPOR = _jobData[5] & 0x0002;
+            if (!_jobPOR && readReg16Bit(DesignCap) == _config.designCapReg())
+            {
+                startJob(jobVerify);
+                // a restore waiting for the init is still to come
+                return _nextJob != jobNone ? JobPending : JobDone;
+            }
+            _jobPOR = true;
+            nextJobStep();
+        }
+        // fall through
+        case 1:
+        {
+            // 2. do not continue until FSTAT.DNR == 0
+            if (readReg16Bit(FStat)&1)
+                return pollJob(waitMs);
+
+            // 3. Initialize configuration
+            _jobData[5] = readReg16Bit(HibCfg);
+            WriteBatch batch;
+            batch.add(CommandReg, 0x90);
+            batch.barrier();
+            batch.add(HibCfg, 0x0);
+            batch.barrier();
+            batch.add(CommandReg, 0x0);
+            batch.barrier();
+
+            // 3.1 OPTION 1 EZ Config (no INI file is needed): 
+            batch.add(DesignCap, _config.designCapReg());
+            batch.add(DQAcc, _config.dQAccReg());
+            if (_config.ichgTermReg() != 0)
+                batch.add(IchgTerm, _config.ichgTermReg());
+            batch.add(VEmpty, _config.vEmptyReg());
+            batch.add(ModelCfg, _config.modelCfgReg());
+            writeBatch(batch);
+            nextJobStep();
+        }
+        // fall through
+        default:
+        {
+            // Do not continue until ModelCFG.Refresh == 0
+            if (readReg16Bit(ModelCfg) & 0x8000)
+                return pollJob(waitMs);
+            writeReg16Bit(HibCfg, _jobData[5]); // Restore Original HibCFG value 
+
+            // 4. clear POR bit
+            resetPOR();
+            return endJob(JobDone);
+        }
+    }
 }
 
-uint16_t MAX17055::readReg16Bit(uint8_t reg)
+MAX17055::jobStatus MAX17055::verifyStep(uint32_t& waitMs)
 {
-  uint16_t value = 0;  
-  _wire->beginTransmission(I2CAddress); 
-  _wire->write(reg);
-  _wire->endTransmission(false);
-  
-  _wire->requestFrom(I2CAddress, (uint8_t) 2); 
-  value  = _wire->read();
-  value |= (uint16_t)_wire->read() << 8;      // value low byte
-  return value;
+    // it can happen the chip loses its settings for some reason without triggering POR
+    // this is a workaround to prevent that
+    bool voltageMatches = (readReg16Bit(VEmpty) & 0xFF80) == (_config.vEmptyReg() & 0xFF80);
+    bool chemistryMatches = (readReg16Bit(ModelCfg) & 0x00F0) == (_config.modelCfgReg() & 0x00F0);
+    if (voltageMatches && chemistryMatches)
+        return endJob(JobDone);
+
+    // configure like after a POR, from step 2 of initStep()
+    _jobPOR = true;
+    startJob(jobInit);
+    nextJobStep();
+    return initStep(waitMs);
 }
+
+MAX17055::jobStatus MAX17055::restoreStep(uint32_t& waitMs)
+{
+    switch (_jobStep)
+    {
+        case 0:
+            writeReg16Bit(RComp0, _jobData[0]);
+            writeReg16Bit(TempCo, _jobData[1]);
+            writeReg16Bit(FullCapNom, _jobData[4]);
+            nextJobStep();
+            waitMs = 350;
+            return JobPending;
+
+        case 1:
+        {
+            uint16_t mixCap = ((uint32_t) readReg16Bit(MixSOC)*readReg16Bit(FullCapNom))/25600;
+            writeReg16Bit(MixCap, mixCap);
+            writeReg16Bit(FullCapRep, _jobData[2]);
+
+            //Write dQacc to 200% of Capacity and dPacc to 200%  
+            uint16_t dQAcc = (_jobData[4] / 16);
+            writeReg16Bit(DPAcc, 0x0C80);
+            writeReg16Bit(DQAcc, dQAcc); 
+            nextJobStep();
+            waitMs = 350;
+            return JobPending;
+        }
+
+        default:
+            writeReg16Bit(Cycles, _jobData[3]);
+            return endJob(JobDone);
+    }
+}
+
+uint16_t MAX17055::crc16(const uint8_t* data, uint8_t length)
+{
+    // CRC-16/CCITT-FALSE, bitwise to keep it small
+    uint16_t crc = 0xFFFF;
+    while (length-- > 0)
+    {
+        crc ^= (uint16_t) *data++ << 8;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+void MAX17055::startJob(uint8_t job)
+{
+    // an init or the settings check of a warm boot isn't abandoned, a restore runs once it's done
+    if ((_job == jobInit || _job == jobVerify) && job == jobRestore)
+    {
+        _nextJob = job;
+        return;
+    }
+    _job = job;
+    _jobStep = 0;
+    _jobPolls = 0;
+}
+
+void MAX17055::nextJobStep()
+{
+    _jobStep++;
+    _jobPolls = 0;
+}
+
+MAX17055::jobStatus MAX17055::pollJob(uint32_t& waitMs)
+{
+    // the polling loops are bounded, a gauge that never gets ready fails the operation
+    if (++_jobPolls > jobMaxPolls)
+        return endJob(JobFailed);
+    waitMs = jobPollMs;
+    return JobPending;
+}
+
+MAX17055::jobStatus MAX17055::endJob(jobStatus status)
+{
+    _job = jobNone;
+    uint8_t next = _nextJob;
+    _nextJob = jobNone;
+    // the job waiting for the settings check follows with the next call, unless configuring failed
+    if (next != jobNone && status == JobDone)
+    {
+        startJob(next);
+        return JobPending;
+    }
+    return status;
+}
+
+MAX17055::jobStatus MAX17055::finishJob()
+{
+    uint32_t waitMs;
+    jobStatus status;
+    while ((status = runJob(waitMs)) == JobPending)
+        _wait(waitMs);
+    return status;
+}
+
+uint16_t MAX17055::verifyMask(uint8_t reg)
+{
+    // bits changed by the gauge itself can't be verified
+    switch (reg)
+    {
+        case Status:     return 0;      // flags are set by the gauge, writes only clear them
+        case CommandReg: return 0;      // write only
+        case ModelCfg:   return 0x7FFF; // Refresh clears once the model is loaded
+        default:         return 0xFFFF;
+    }
+}
+
+uint8_t MAX17055::batchRun(const WriteBatch& batch, uint8_t first)
+{
+    // number of sorted entries starting at first that can be sent as one burst
+    uint8_t n = 1;
+    while (first + n < batch._count && n < burstWriteRegs &&
+           batch._entries[first+n].stage == batch._entries[first].stage &&
+           batch._entries[first+n].reg == batch._entries[first].reg + n)
+    {
+        n++;
+    }
+    return n;
+}
+
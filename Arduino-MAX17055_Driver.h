@@ -33,6 +33,7 @@
 
 #include <Arduino.h>
 #include <Wire.h>
+#include <Arduino-MAX17055_GaugeCore.h>
 
 /**********************************************************************
 * @brief MAX17055 - The MAX17055 is a low 7μA operating current fuel gauge that implements 
@@ -63,7 +64,9 @@
 // in the ino file.
 
 
-class MAX17055
+// Driver of the ModelGauge m5 EZ gauges on top of FuelGaugeCore. Works with the MAX17260 and, except
+// for init(), the MAX17201 when constructed with their traits
+class MAX17055 : public FuelGaugeCore
 {
   public:
     // register addresses 
@@ -98,6 +101,14 @@ class MAX17055
       MixSOC      = 0x0D,
       FilterCfg   = 0x29, // sets the averaging time period for all A/D readings, for mixing OCV results and coulomb count results
       SOCHold     = 0xD3, // How low/high percentage (e.g. 99%) is held depending on voltage
+      TimeToFull  = 0x20, // How long until the battery is full, same format as TimeToEmpty
+      AvSOC       = 0x0E, // Available State of Charge, accounts for the current load
+      AvCap       = 0x1F, // Available Capacity, accounts for the current load
+      VFSOC       = 0xFF, // State of Charge of the voltage fuel gauge only
+      ConfigReg   = 0x1D, // Config register, alert and shutdown control
+      VAlrtTh     = 0x01, // voltage alert thresholds
+      SAlrtTh     = 0x03, // SOC alert thresholds
+      ShdnTimer   = 0x3F, // delay before shutdown
     };
 
     enum modelID
@@ -107,24 +118,513 @@ class MAX17055
       LiFePO4 = 0x60, // for LiFePO4 batteries
     };
 
+    // Gauge configuration for init() with all register values calculated when it is built, so
+    // init() does no conversions. Built with chained setters, e.g. for LiFePO4:
+    //   constexpr MAX17055::Config config = MAX17055::Config().capacity(6000).emptyVoltage(300, 360)
+    //                                           .model(MAX17055::LiFePO4).resistSensor(0.01);
+    // With constexpr, an out of range value stops the compilation with an error about calling the
+    // non-constexpr configOutOfRange(). At runtime it makes valid() false and init() refuses the config.
+    class Config
+    {
+      public:
+        constexpr Config() : Config(0, 330, 388, Generic, false, 0.01f, 0) {}
+
+        // mAh, has to be set
+        constexpr Config capacity(uint16_t mAh) const
+        {
+          return Config(check(capacityOk(mAh, _resist), mAh), _vEmpty, _vRecovery, _modelID, _vCharge, _resist, _ichgTerm);
+        }
+        // empty and recovery voltage in 10mV steps (330 = 3.3V), recovery has a resolution of 40mV
+        constexpr Config emptyVoltage(uint16_t vEmpty, uint16_t vRecovery) const
+        {
+          return Config(_capacity, check(vEmptyOk(vEmpty), vEmpty), check(vRecoveryOk(vRecovery), vRecovery),
+                        _modelID, _vCharge, _resist, _ichgTerm);
+        }
+        // one of modelID, set vCharge for charge voltages above 4.275V
+        constexpr Config model(uint8_t modelID, bool vCharge = false) const
+        {
+          return Config(_capacity, _vEmpty, _vRecovery, check(modelOk(modelID), modelID), vCharge, _resist, _ichgTerm);
+        }
+        // ohm
+        constexpr Config resistSensor(float ohm) const
+        {
+          return Config(_capacity, _vEmpty, _vRecovery, _modelID, _vCharge,
+                        check(ohm > 0 && capacityOk(_capacity, ohm) && chargeTermOk(_ichgTerm, ohm), ohm), _ichgTerm);
+        }
+        // charge termination current in mA, 0 leaves the gauge's default
+        constexpr Config chargeTermination(uint16_t mA) const
+        {
+          return Config(_capacity, _vEmpty, _vRecovery, _modelID, _vCharge, _resist, check(chargeTermOk(mA, _resist), mA));
+        }
+
+        constexpr bool valid() const { return _valid; }
+        constexpr uint16_t capacity() const { return _capacity; }
+        constexpr uint16_t emptyVoltage() const { return _vEmpty; }
+        constexpr float resistSensor() const { return _resist; }
+
+        // register values
+        constexpr uint16_t designCapReg() const { return _designCap; }
+        constexpr uint16_t dQAccReg() const { return _designCap / 32; }
+        constexpr uint16_t vEmptyReg() const { return _vEmptyReg; }
+        constexpr uint16_t modelCfgReg() const { return _modelCfg; }
+        constexpr uint16_t ichgTermReg() const { return _ichgTermReg; }
+        // identifies the battery setup, stored with LearnedParams
+        constexpr uint16_t fingerprint() const
+        {
+          return (uint16_t) ((uint16_t) (_designCap * 31u + _vEmptyReg) * 31u + (_modelCfg & 0x04F0));
+        }
+
+      private:
+        uint16_t _capacity;
+        uint16_t _vEmpty;
+        uint16_t _vRecovery;
+        uint8_t _modelID;
+        bool _vCharge;
+        float _resist;
+        uint16_t _ichgTerm;
+
+        uint16_t _designCap;
+        uint16_t _vEmptyReg;
+        uint16_t _modelCfg;
+        uint16_t _ichgTermReg;
+        bool _valid;
+
+        constexpr Config(uint16_t capacity, uint16_t vEmpty, uint16_t vRecovery, uint8_t modelID, bool vCharge,
+                         float resist, uint16_t ichgTerm)
+          : _capacity(capacity), _vEmpty(vEmpty), _vRecovery(vRecovery), _modelID(modelID), _vCharge(vCharge),
+            _resist(resist), _ichgTerm(ichgTerm),
+            //calcuation based on AN6358 page 13 figure 1.3, but reversed to get the register value
+            _designCap(resist > 0 ? (uint16_t) (capacity / (5e-3f / resist)) : 0),
+            _vEmptyReg(emptyVoltageReg(vEmpty, vRecovery)),
+            _modelCfg(MAX17055::modelCfgReg(vCharge, modelID)),
+            _ichgTermReg(resist > 0 ? (uint16_t) (ichgTerm / (1.5625e-3f / resist)) : 0),
+            _valid(capacity > 0 && resist > 0 && capacityOk(capacity, resist) && vEmptyOk(vEmpty) &&
+                   vRecoveryOk(vRecovery) && modelOk(modelID) && chargeTermOk(ichgTerm, resist)) {}
+
+        // register field limits, vEmpty below 2V is most likely a wrong unit
+        static constexpr bool capacityOk(uint16_t mAh, float ohm) { return mAh / (5e-3f / ohm) < 65536.0f; }
+        static constexpr bool vEmptyOk(uint16_t v) { return v >= 200 && v <= 511; }
+        static constexpr bool vRecoveryOk(uint16_t v) { return v >= 200 && v <= 508; }
+        static constexpr bool modelOk(uint8_t id) { return id == Generic || id == NCR_NCA || id == LiFePO4; }
+        static constexpr bool chargeTermOk(uint16_t mA, float ohm) { return mA / (1.5625e-3f / ohm) < 32768.0f; }
+
+        template<class T> static constexpr T check(bool ok, T value) { return ok ? value : configOutOfRange(value); }
+        // not constexpr on purpose, see above
+        template<class T> static T configOutOfRange(T value) { return value; }
+    };
+
+    // result of runJob()
+    enum jobStatus
+    {
+      JobDone    = 0,
+      JobPending = 1, // call runJob() again after waitMs
+      JobFailed  = 2, // the gauge didn't get ready within the polling limit
+    };
+
+    // result of a register write in a WriteBatch
+    enum writeStatus
+    {
+      WriteFailed   = 0, // bus error, or the read back value did not match after all retries
+      WriteSent     = 1, // written without verification
+      WriteVerified = 2, // read back value matched
+      WriteRetried  = 3, // read back value matched after writing it again
+    };
+
+    // Collects register writes so they can be sent with as few transactions as possible.
+    // On flush the writes are sorted by address and adjacent addresses are merged into burst writes.
+    // Writes queued before barrier() are always sent before the ones queued after it.
+    // ModelCfg is always written last because writing it starts a model refresh.
+    class WriteBatch
+    {
+      public:
+        // number of register writes a batch can hold, enough for init() with room to spare
+        static const uint8_t maxWrites = 12;
+
+        WriteBatch() : _count(0), _stage(0) {}
+        // returns false if the batch is full, a second write to the same register replaces the first one
+        bool add(uint8_t reg, uint16_t value);
+        void barrier();
+        void clear();
+        uint8_t count() const { return _count; }
+        // results of the last writeBatch(), index i refers to the order the writes were sent in
+        uint8_t reg(uint8_t i) const { return _entries[i].reg; }
+        writeStatus status(uint8_t i) const { return (writeStatus) _entries[i].status; }
+        uint8_t failures() const;
+
+      private:
+        friend class MAX17055;
+        struct entry
+        {
+          uint8_t reg;
+          uint8_t stage;
+          uint8_t status;
+          uint16_t value;
+        };
+        entry _entries[maxWrites];
+        uint8_t _count;
+        uint8_t _stage;
+    };
+
+    // Raw register values read together by readSnapshot(), convert them with the to...() methods
+    struct Snapshot
+    {
+      uint16_t status;
+      uint16_t repCap;
+      uint16_t repSOC;
+      uint16_t age;
+      int16_t  temperature;
+      uint16_t vCell;
+      int16_t  current;
+      int16_t  avgCurrent;
+      uint16_t fullCapRep;
+      uint16_t timeToEmpty;
+      uint16_t cycles;
+      uint16_t avgVCell;
+      uint32_t micros;   // host micros() when the bursts completed
+    };
+
+    // Estimates when the gauge updates its measurement registers, which happens once per ADC cycle
+    // of 175.8ms. When Current changes between two reads, the update happened between their
+    // timestamps. Every change narrows this window, projected by whole ADC cycles, until it is
+    // small enough to schedule reads just after the next update.
+    // Reads more than one cycle apart don't narrow the window, and a constant Current gives no information.
+    class AdcPhase
+    {
+      public:
+        static const uint32_t periodMicros = 175800;
+        static const uint32_t lockedWindowMicros = 5000; // uncertainty at which the phase counts as locked
+        static const uint32_t guardMicros = 1000;        // margin after the estimated update
+
+        constexpr AdcPhase() : _edge(0), _window(0), _lastMicros(0), _lastCurrent(0), _valid(false), _hasLast(false) {}
+        void observe(int16_t current, uint32_t micros);
+        void reset() { _valid = false; _hasLast = false; }
+        bool locked() const { return _valid && _window <= lockedWindowMicros; }
+        // uncertainty of the update time in us
+        uint32_t window() const { return _window; }
+        // host micros() just after the next update at or after now, now if the phase is unknown
+        uint32_t nextConversion(uint32_t now) const;
+        // host micros() by which the first update after micros has happened for sure, without the guard
+        // margin. Only meaningful once the phase is known
+        uint32_t updateAfter(uint32_t micros) const;
+        // host micros() of the next read at or after now that either gets a new update or narrows the window,
+        // alternating between the middle and the end of the window until the phase is locked
+        uint32_t nextRead(uint32_t now) const;
+
+      private:
+        uint32_t _edge;   // latest time the update may have happened
+        uint32_t _window; // the update happened within this many us before _edge
+        uint32_t _lastMicros;
+        int16_t _lastCurrent;
+        bool _valid;
+        bool _hasLast;
+    };
+
+    // Host side filter for the instantaneous Current and VCell of snapshots, responding faster than
+    // AvgCurrent/AvgVCell without changing FilterCfg. Exponential moving average on raw register
+    // values with a gain adapting to the observed noise: a step larger than 4x the mean deviation
+    // resets the gain to 1/2, errors within 2x the mean deviation halve it per sample down to 1/64.
+    // Shifts and adds only, no multiplication, and division only by a power of two.
+    // Owned by the application and fed from its snapshots, e.g. current.update(snap.current), then
+    // gauge.toCurrent(current.value()) gives mA.
+    class NoiseFilter
+    {
+      public:
+        constexpr NoiseFilter() : _value(0), _deviation(0), _shift(0), _primed(false) {}
+        int32_t update(int32_t raw);
+        int32_t value() const
+        {
+          const int32_t half = 1 << (fracBits - 1);
+          return _value < 0 ? -((half - _value) >> fracBits) : (_value + half) >> fracBits;
+        }
+        void reset() { _primed = false; }
+
+      private:
+        static const uint8_t fracBits = 8;  // fixed point fraction bits of the state
+        static const uint8_t minShift = 1;
+        static const uint8_t maxShift = 6;
+        static const int32_t noiseFloor = 2 << fracBits; // steps below 2 LSB are never treated as steps
+
+        int32_t _value;
+        int32_t _deviation; // mean absolute deviation from the filtered value
+        uint8_t _shift;     // gain is 1/2^_shift
+        bool _primed;
+    };
+
+    // Time to empty in hours with a confidence band, see TtePredictor
+    struct TteEstimate
+    {
+      bool  valid;    // false while charging, idle or without enough history
+      float hours;
+      float hoursMin; // with the average load 2 standard deviations higher
+      float hoursMax; // with the average load 2 standard deviations lower, infinite if that's no discharge
+    };
+
+    // Host side time to empty from RepCap and a long term average of Current. Unlike AvgCurrent the
+    // average is weighted with the time between snapshots, so it is the charge drawn per time over
+    // the time constant and follows the duty cycle of bursty loads instead of every burst.
+    // Until the history covers the time constant it is a plain average of all samples.
+    // The band comes from the variance of the load and the effective number of samples in the average.
+    // Fixed memory, O(1) per update. Works on raw values, RepCap / Current is independent of the sense resistor.
+    // Owned by the application and fed with its snapshots, e.g. tte.update(snap).
+    class TtePredictor
+    {
+      public:
+        constexpr TtePredictor() : _mean(0), _variance(0), _weightSq(0), _elapsed(0), _tau(1800), _lastMicros(0), _repCap(0), _samples(0) {}
+        // time constant of the load average, default 30 minutes
+        void setTimeConstant(float seconds) { _tau = seconds; }
+        void update(int16_t current, uint16_t repCap, uint32_t micros);
+        void update(const Snapshot& snap) { update(snap.current, snap.repCap, snap.micros); }
+        void reset() { _samples = 0; }
+        TteEstimate estimate() const;
+
+      private:
+        float _mean;     // average Current, raw
+        float _variance; // of Current around the average
+        float _weightSq; // sum of the squared sample weights in the average
+        float _elapsed;  // history in the average in s, up to the time constant
+        float _tau;
+        uint32_t _lastMicros;
+        uint16_t _repCap;
+        uint8_t _samples;
+    };
+
+    // Statistics of the samples taken by sampleCurrent(), current in mA and voltage in V
+    struct SampleStats
+    {
+      struct stats
+      {
+        float mean;
+        float min;
+        float max;
+        float variance;
+      };
+      uint8_t count;      // fresh samples taken
+      uint8_t duplicates; // reads that returned an already sampled conversion and were discarded
+      stats current;
+      stats voltage;
+    };
+
+    // All State of Charge and capacity outputs of the fuel gauge, see readSocSet()
+    struct SocSet
+    {
+      float vfSOC;      // % voltage fuel gauge only
+      float avSOC;      // % available to the application under the present load
+      float mixSOC;     // % mix of the coulomb counter and the voltage fuel gauge
+      float repSOC;     // % reported, same as getSOC()
+      float avCap;      // mAh
+      float mixCap;     // mAh
+      float repCap;     // mAh, same as getReportedCapacity()
+      float fullCapRep; // mAh
+    };
+
+    // How often the consistency check of readSnapshot() found an implausible value, how often the
+    // re-read returned a plausible one instead, and how often the re-read failed or was implausible too
+    struct ConsistencyStats
+    {
+      uint16_t suspicious;
+      uint16_t corrected;
+      uint16_t unresolved;
+    };
+
+    // Learned parameters with everything needed to store them, see getLearnedParameters().
+    // Packed and fixed size, so it can be copied to EEPROM or flash as it is
+    struct LearnedParams
+    {
+      uint8_t version;      // layout of the record, learnedParamsVersion
+      uint16_t rComp0;
+      uint16_t tempCo;
+      uint16_t fullCapRep;
+      uint16_t cycles;
+      uint16_t fullCapNom;
+      uint16_t config;      // Config::fingerprint() of the gauge the parameters were learned with
+      uint32_t timestamp;   // given by the application, e.g. seconds since epoch
+      uint16_t crc;         // CRC-16/CCITT-FALSE of the bytes before
+    } __attribute__((packed));
+    static const uint8_t learnedParamsVersion = 1;
+
+    // Estimated bus usage of an operation, see CostModel
+    struct BusCost
+    {
+      uint16_t bytes;        // bytes on the bus including address bytes
+      uint16_t transactions; // START to STOP sequences
+      uint32_t micros;       // bus time, software overhead and waits are not included
+    };
+
+    // Compile time estimate of the bus time the driver's operations need at a given I2C clock.
+    // Every byte takes 9 clocks (8 data bits + ACK), START, repeated START and STOP are counted
+    // as one clock each. Polling loops are counted with the number of polls passed in.
+    // e.g. static_assert(MAX17055::CostModel::snapshot(400000).micros < 1200, "too slow");
+    class CostModel
+    {
+      public:
+        static constexpr BusCost read(uint32_t clockHz)
+        {
+          return burstRead(1, clockHz);
+        }
+        static constexpr BusCost write(uint32_t clockHz)
+        {
+          return burstWrite(1, clockHz);
+        }
+        // register address + data, then repeated START with address + data, split into Wire buffer sized chunks
+        static constexpr BusCost burstRead(uint16_t count, uint32_t clockHz)
+        {
+          return make(3 * chunks(count, burstReadRegs) + 2 * count, chunks(count, burstReadRegs), 1, clockHz);
+        }
+        static constexpr BusCost burstWrite(uint16_t count, uint32_t clockHz)
+        {
+          return make(2 * chunks(count, burstWriteRegs) + 2 * count, chunks(count, burstWriteRegs), 0, clockHz);
+        }
+        static constexpr BusCost snapshot(uint32_t clockHz)
+        {
+          return add(burstRead(snapshotCountA, clockHz), burstRead(snapshotCountB, clockHz));
+        }
+        // init() when a POR is detected, fstatPolls and refreshPolls are the reads of the two polling loops
+        // add one write for a Config with chargeTermination()
+        static constexpr BusCost initPOR(uint32_t clockHz, uint16_t fstatPolls = 1, uint16_t refreshPolls = 1)
+        {
+          return add(times(read(clockHz), 3 + fstatPolls + refreshPolls), times(write(clockHz), 9));
+        }
+        // a gauge that kept its configuration: beginInit() reads Status and DesignCap
+        static constexpr BusCost initWarm(uint32_t clockHz)
+        {
+          return times(read(clockHz), 2);
+        }
+        // the settings check of the runJob() call after it reads VEmpty and ModelCfg.
+        // Blocking begin() and init() do both, initWarm() + initWarmVerify()
+        static constexpr BusCost initWarmVerify(uint32_t clockHz)
+        {
+          return times(read(clockHz), 2);
+        }
+        // restoreLearnedParameters() without its two 350ms waits
+        static constexpr BusCost restore(uint32_t clockHz)
+        {
+          return add(times(read(clockHz), 2), times(write(clockHz), 8));
+        }
+        // worst cases: init() with both polling loops running until they give up, sampleCurrent(n)
+        // using all of its reads
+        static constexpr BusCost initWorst(uint32_t clockHz)
+        {
+          // a warm boot finding changed settings reads DesignCap, VEmpty and ModelCfg before it configures
+          return add(initPOR(clockHz, jobMaxPolls + 1, jobMaxPolls + 1), times(read(clockHz), 3));
+        }
+        static constexpr BusCost sampleCurrent(uint8_t n, uint32_t clockHz)
+        {
+          return times(burstRead(2, clockHz), maxSampleReads(n));
+        }
+
+      private:
+        static constexpr uint16_t chunks(uint16_t count, uint8_t perChunk)
+        {
+          return (count + perChunk - 1) / perChunk;
+        }
+        static constexpr BusCost make(uint16_t bytes, uint16_t transactions, uint8_t restarts, uint32_t clockHz)
+        {
+          return BusCost{bytes, transactions,
+            (uint32_t) ((((uint64_t) bytes * 9 + (uint64_t) transactions * (2 + restarts)) * 1000000UL + clockHz - 1) / clockHz)};
+        }
+        static constexpr BusCost add(BusCost a, BusCost b)
+        {
+          return BusCost{(uint16_t) (a.bytes + b.bytes), (uint16_t) (a.transactions + b.transactions), a.micros + b.micros};
+        }
+        static constexpr BusCost times(BusCost a, uint16_t n)
+        {
+          return BusCost{(uint16_t) (a.bytes * n), (uint16_t) (a.transactions * n), a.micros * n};
+        }
+    };
+
+    // Set of registers read with the fewest burst reads, planned at compile time, see read()
+    //   MAX17055::ReadPlan<MAX17055::TimeToEmpty, MAX17055::TimeToFull> plan;
+    //   uint16_t values[plan.size]; // in the order of the template arguments
+    //   sensor.read(plan, values);
+    template<uint8_t... Regs> class ReadPlan;
+
     //variables
     
     
     //methods
-    MAX17055(void); //Constructor prototype
-    MAX17055(uint16_t batteryCapacity); //Constructor allowing user to set capacity of battery
+    // The constructors only store the configuration and don't touch the bus, so global instances are
+    // constant initialized. begin() or init() applies it once Wire is running
+    constexpr MAX17055() : FuelGaugeCore(MAX17055Traits) {}
+    constexpr MAX17055(uint16_t batteryCapacity) : FuelGaugeCore(MAX17055Traits), _config(Config().capacity(batteryCapacity)) {}
+    constexpr MAX17055(const Config& config) : FuelGaugeCore(MAX17055Traits), _config(config) {}
+    // another m5 gauge, e.g. MAX17055(MAX17260Traits)
+    constexpr explicit MAX17055(const GaugeTraits& chip, const Config& config = Config())
+      : FuelGaugeCore(chip), _config(config) {}
+
+    // applies the configuration given to the constructor like init() does, with one batched write
+    // when the gauge needs to be configured. Returns false if the gauge doesn't respond or the config isn't valid.
+    // It returns after the settings check of a warm boot, only beginInit() and runJob() leave it for later
+    bool begin(bool& por, TwoWire *theWire = &Wire, void (*wait)(uint32_t) = &delay);
+    bool begin(TwoWire *theWire = &Wire);
 
     // example for LiFePO4:
     // bool success = sensor.init(6000, 300, 360, MAX17055::modelID::LiFePO4, false, 0.01, por);
     // set vCharge to true if charge voltage is greater than 4.275
     bool init(uint16_t batteryCapacity, uint16_t vEmpty, uint16_t vRecovery, uint8_t modelID, bool vCharge, 
               float resistSensor, bool& por, TwoWire *theWire = &Wire, void (*wait)(uint32_t) = &delay);
+    // same with a prepared Config, returns false if the config isn't valid
+    // Without a POR and with the expected DesignCap the gauge most likely kept its configuration, and
+    // init() only reads VEmpty and ModelCfg in addition to check the other settings
+    bool init(const Config& config, bool& por, TwoWire *theWire = &Wire, void (*wait)(uint32_t) = &delay);
+
 
+    // Non-blocking versions of init() and restoreLearnedParameters(). After starting the operation call
+    // runJob() until it doesn't return JobPending any more, waiting at least waitMs between the calls.
+    // Every call does a bounded number of transactions and never waits itself.
+    // beginInit() returns false if the gauge doesn't respond. On a warm boot it is done after reading Status
+    // and DesignCap, the check of the other settings stays pending and is done by the next runJob() call,
+    // which configures the gauge if they changed.
+    // A restore started during an init or the settings check runs after them, a new beginInit() abandons
+    // the operations still running and checks the settings again
+    bool beginInit(uint16_t batteryCapacity, uint16_t vEmpty, uint16_t vRecovery, uint8_t modelID, bool vCharge, 
+                   float resistSensor, TwoWire *theWire = &Wire);
+    bool beginInit(const Config& config, TwoWire *theWire = &Wire);
+    void beginRestoreLearnedParameters(uint16_t rComp0, uint16_t tempCo, uint16_t fullCapRep, uint16_t cycles, uint16_t fullCapNom);
+    jobStatus runJob(uint32_t& waitMs);
+    bool jobPending() const { return _job != jobNone; }
+    // true if the last init found a POR or changed settings and configured the gauge
+    bool initPOR() const { return _jobPOR; }
 
     // It is recommended to save the learned capacity parameters every time bit 6 of the Cycles register toggles
     void getLearnedParameters(uint16_t& rcomp0, uint16_t& tempCo, uint16_t& fullCapRep, uint16_t& cycles, uint16_t& fullCapNom);
     void restoreLearnedParameters(uint16_t rComp0, uint16_t tempCo, uint16_t fullCapRep, uint16_t cycles, uint16_t fullCapNom);
+    // same as a record, returns false on a bus error
+    bool getLearnedParameters(LearnedParams& params, uint32_t timestamp = 0);
+    // refuses records of another version, with a wrong CRC or learned with another Config
+    bool restoreLearnedParameters(const LearnedParams& params);
+    bool beginRestoreLearnedParameters(const LearnedParams& params);
+    bool checkLearnedParameters(const LearnedParams& params) const;
     
+    // Shutdown for shipping and storage: the gauge stops measuring and draws the least current, keeping
+    // its registers as long as the battery stays connected. Any activity on SDA or SCL wakes it up again.
+    // shutdown() takes effect after the shutdown timeout, 45s by default. setShutdownTimeout() rounds up
+    // to 45s * 2^n, up to 1.6h, and returns the seconds set
+    uint16_t setShutdownTimeout(uint16_t seconds);
+    // returns false on a bus error, without having changed anything if the error was in the reads
+    bool shutdown();
+    // wakes the gauge and checks its configuration with the warm boot path of init(). Needs the Config
+    // given to the constructor or init(), por tells if the gauge lost it and had to be configured again.
+    // Hibernation is enabled again with the HibCfg saved by shutdown(), or the default after an MCU reset
+    bool wake(bool& por);
+
+    // Alerts on the ALRT pin, e.g. to wake the MCU, see MAX17055Scheduler::notifyAlert().
+    // The thresholds are in mV with 20mV resolution and whole percent of RepSOC
+    void setVoltageAlert(uint16_t minMv, uint16_t maxMv);
+    void setSOCAlert(uint8_t minPercent, uint8_t maxPercent);
+    void enableAlerts(bool enable);
+    // alert flags of the Status register (alertVoltageLow, ...), clearAlerts() releases the ALRT pin
+    uint16_t getAlerts();
+    void clearAlerts();
+    static const uint16_t alertCurrentLow  = 0x0004;
+    static const uint16_t alertCurrentHigh = 0x0040;
+    static const uint16_t alertVoltageLow  = 0x0100;
+    static const uint16_t alertTempLow     = 0x0200;
+    static const uint16_t alertSOCLow      = 0x0400;
+    static const uint16_t alertVoltageHigh = 0x1000;
+    static const uint16_t alertTempHigh    = 0x2000;
+    static const uint16_t alertSOCHigh     = 0x4000;
+    static const uint16_t alertAll         = 0x7744;
+
     // get power-on reset
     bool getPOR();
     void resetPOR();
@@ -158,27 +658,218 @@ class MAX17055
     float getAge();
     bool  getPresent();
 
+    // sends all writes of the batch, returns false if any transaction failed
+    // the batch is left sorted in the order it was written, call clear() to reuse it
+    bool writeBatch(WriteBatch& batch);
+    // with verification enabled writeBatch() reads the written registers back with burst reads
+    // and writes mismatching registers again, up to retries times, before it goes on to the next stage
+    void setWriteVerify(bool enable, uint8_t retries = 2);
+
+    // reads the registers of the plan into out, in the order they were listed. Returns false on a bus error
+    template<uint8_t... Regs> bool read(const ReadPlan<Regs...>& plan, uint16_t* out);
+
+    // reads all SOC and capacity registers with 4 burst reads instead of 8 single reads
+    bool readSocSet(SocSet& socs);
+
+    // reads the most used measurements with two burst reads, returns false on a bus error
+    // the snapshot is timestamped and used to track the phase of the ADC updates
+    bool readSnapshot(Snapshot& snap);
+    // also copies the bus error counters after the reads, see busHealth()
+    bool readSnapshot(Snapshot& snap, BusHealth& health);
+    const AdcPhase& adcPhase() const { return _adcPhase; }
+    // With the consistency check enabled readSnapshot() reads RepSOC and VCell again if they look like a
+    // bus error: all bits 1, VCell all bits 0, or a larger change since the last snapshot than the current
+    // allows. The re-read value is only taken if it's plausible, else the first one is kept and counted as
+    // unresolved. readSnapshot() returns false if the re-read fails
+    void setConsistencyCheck(bool enable) { consistencyCheck = enable; }
+    const ConsistencyStats& consistencyStats() const { return _consistency; }
+
+    // takes n samples of Current and VCell, one per ADC update, waiting with the wait function between them.
+    // The currents are stored in buffer (mA, n entries) unless it's NULL. count < n in the result means a bus
+    // error or that no new conversions could be detected
+    SampleStats sampleCurrent(uint8_t n, float* buffer = NULL);
+
+    // Bounds of the loops for the worst case execution time, with CostModel for the bus time. Each
+    // transaction is bounded by the Wire timeout of the platform, every wait by the wait function.
+    // runJob() calls of init() including the settings check of a warm boot, and the time waited between them
+    static constexpr uint16_t maxInitJobCalls() { return 2 + 2 * (jobMaxPolls + 1); }
+    static constexpr uint16_t maxInitWaitMs() { return 2 * jobMaxPolls * jobPollMs; }
+    static constexpr uint8_t maxRestoreJobCalls() { return 3; }
+    static constexpr uint16_t maxSampleReads(uint8_t n) { return 4 * (uint16_t) n + 8; }
+    static constexpr uint8_t maxWakeProbes() { return wakeProbes; }
+
+    // conversion of raw register values, e.g. from a Snapshot
+    float toCapacity(uint16_t raw);     // mAh
+    float toCurrent(int16_t raw);       // mA, +ve current is charging, -ve is discharging
+    float toVoltage(uint16_t raw);      // V
+    float toPercentage(uint16_t raw);   // %
+    float toTemperature(int16_t raw);   // degC
+    float toHours(uint16_t raw);        // h
+
 private:
     //variables
     float resistSensor = 0.01; //default internal resist sensor
-    uint8_t I2CAddress = 0x36;
 
-    TwoWire *_wire = &Wire;
+    bool verifyWrites = false;
+    uint8_t verifyRetries = 2;
+
+    bool consistencyCheck = false;
+    ConsistencyStats _consistency = {0, 0, 0};
+    bool _guardValid = false;
+    uint16_t _guardSOC = 0;
+    uint16_t _guardVCell = 0;
+    uint32_t _guardMicros = 0;
+    static const uint16_t vCellJumpLimit = 6400; // 0.5V, steps of the load through the cell resistance
+    static const uint16_t socJumpMargin = 256;   // 1%
+
+    // multi-step operation in progress, see runJob()
+    enum jobType
+    {
+      jobNone    = 0,
+      jobInit    = 1,
+      jobRestore = 2,
+      jobVerify  = 3, // settings check left over from a warm boot init
+    };
+    static const uint8_t jobMaxPolls = 200; // polling FStat.DNR or ModelCfg.Refresh gives up after 2s
+    static const uint8_t jobPollMs = 10;
+    uint8_t _job = jobNone;
+    uint8_t _nextJob = jobNone; // restore started when the init is done
+    uint8_t _jobStep = 0;
+    uint8_t _jobPolls = 0;
+    bool _jobPOR = false;
+    uint16_t _jobData[6] = {};
+    uint16_t _hibCfg = 0; // saved by shutdown(), restored by wake()
+    static const uint8_t wakeProbes = 5;
+    static const uint16_t hibCfgDefault = 0x870C;
+    Config _config;
+
+    AdcPhase _adcPhase;
+
     void (*_wait)(uint32_t) = &delay;
     
     //Based on "Standard Register Formats" AN6358, figure 1.3. 
     //Multipliers are constants used to multiply register value in order to get final result
-    float capacity_multiplier_mAH = (5e-3)/resistSensor; //refer to row "Capacity"
-    float current_multiplier_mV = (1.5625e-3)/resistSensor; //refer to row "Current"
-    float voltage_multiplier_V = 7.8125e-5; //refer to row "Voltage"
-    float time_multiplier_Hours = 5.625/3600.0; //Least Significant Bit= 5.625 seconds, 3600 converts it to Hours. refer to AN6358 pg 13 figure 1.3 in row "Time"
-    float percentage_multiplier = 1.0/256.0; //refer to row "Percentage"
+    float capacity_multiplier_mAH = _traits->capacityLSB/resistSensor; //refer to row "Capacity"
+    float current_multiplier_mV = _traits->currentLSB/resistSensor; //refer to row "Current"
+    float voltage_multiplier_V = _traits->voltageLSB; //refer to row "Voltage"
+    float time_multiplier_Hours = _traits->timeLSB; //Least Significant Bit= 5.625 seconds, converted to Hours. refer to AN6358 pg 13 figure 1.3 in row "Time"
+    float percentage_multiplier = _traits->percentLSB; //refer to row "Percentage"
     
+    // readSnapshot() reads Status..AvgCurrent and FullCapRep..AvgVCell
+    static const uint8_t snapshotFirstA = Status;
+    static const uint8_t snapshotCountA = AvgCurrent - Status + 1;
+    static const uint8_t snapshotFirstB = FullCapRep;
+    static const uint8_t snapshotCountB = AvgVCell - FullCapRep + 1;
+
     //methods
-    uint16_t readReg16Bit(uint8_t reg);
-    void writeReg16Bit(uint8_t reg, uint16_t value);
+    static uint16_t verifyMask(uint8_t reg);
+    jobStatus initStep(uint32_t& waitMs);
+    jobStatus verifyStep(uint32_t& waitMs);
+    jobStatus restoreStep(uint32_t& waitMs);
+    void startJob(uint8_t job);
+    void nextJobStep();
+    jobStatus pollJob(uint32_t& waitMs);
+    jobStatus endJob(jobStatus status);
+    jobStatus finishJob();
+    static uint8_t batchRun(const WriteBatch& batch, uint8_t first);
+    void verifyStage(WriteBatch& batch, uint8_t first, uint8_t end);
+    static uint16_t crc16(const uint8_t* data, uint8_t length);
+    bool checkConsistency(Snapshot& snap);
+    bool recheck(uint8_t reg, uint16_t& value, float limit, bool& read);
+    bool plausible(uint8_t reg, uint16_t value, float limit) const;
+    // vRecovery has a resolution of 40mV in the Reg
+    static constexpr uint16_t emptyVoltageReg(uint16_t vEmpty, uint16_t vRecovery)
+    {
+      return ((vEmpty << 7) & 0xFF80) | ((vRecovery >> 2) & 0x007F);
+    }
+    static constexpr uint16_t modelCfgReg(bool vChg, uint8_t modelID)
+    {
+      return 0x8000 | (vChg ? 0x400 : 0) | (modelID & 0xF0);
+    }
    };
 
+// Registers closer than burstMaxGap are read in the same burst, because reading the unneeded
+// registers in between is cheaper than starting another transaction. Bursts are split at the
+// Wire buffer size. The bursts are found at compile time by scanning the address space from
+// 0x00 upwards, only the resulting start and end address of every register's burst is stored.
+template<uint8_t... Regs>
+class MAX17055::ReadPlan
+{
+  public:
+    static_assert(sizeof...(Regs) > 0, "ReadPlan needs at least one register");
+
+    static constexpr uint8_t size = sizeof...(Regs);
+    // number of burst reads needed
+    static constexpr uint8_t bursts() { return countFrom(0); }
+
+  private:
+    friend class MAX17055;
+
+    static constexpr bool wanted(uint16_t) { return false; }
+    template<class... T> static constexpr bool wanted(uint16_t reg, uint8_t first, T... rest)
+    {
+      return reg == first || wanted(reg, rest...);
+    }
+    // first requested register at or after reg, 256 if there is none
+    static constexpr uint16_t nextWanted(uint16_t reg)
+    {
+      return (reg > 255 || wanted(reg, Regs...)) ? reg : nextWanted(reg + 1);
+    }
+    // last register of the burst that starts at first and currently ends at last
+    static constexpr uint16_t burstEnd(uint16_t first, uint16_t last)
+    {
+      return (nextWanted(last + 1) < 256 && nextWanted(last + 1) - last - 1 <= burstMaxGap &&
+              nextWanted(last + 1) - first < burstReadRegs) ? burstEnd(first, nextWanted(last + 1)) : last;
+    }
+    static constexpr uint8_t countFrom(uint16_t reg)
+    {
+      return nextWanted(reg) > 255 ? 0 : 1 + countFrom(burstEnd(nextWanted(reg), nextWanted(reg)) + 1);
+    }
+    // first and last register of the burst containing reg, scanning the bursts from "from" upwards
+    static constexpr uint8_t burstFirst(uint8_t reg, uint16_t from = 0)
+    {
+      return reg <= burstEnd(nextWanted(from), nextWanted(from)) ? nextWanted(from)
+             : burstFirst(reg, burstEnd(nextWanted(from), nextWanted(from)) + 1);
+    }
+    static constexpr uint8_t burstLast(uint8_t reg)
+    {
+      return burstEnd(burstFirst(reg), burstFirst(reg));
+    }
+};
+
+template<uint8_t... Regs> constexpr uint8_t MAX17055::ReadPlan<Regs...>::size;
+
+template<uint8_t... Regs>
+bool MAX17055::read(const ReadPlan<Regs...>&, uint16_t* out)
+{
+    typedef ReadPlan<Regs...> plan;
+    static const uint8_t regs[] = { Regs... };
+    static const uint8_t first[] = { plan::burstFirst(Regs)... };
+    static const uint8_t last[] = { plan::burstLast(Regs)... };
+
+    bool success = true;
+    beginBurst();
+    for (uint8_t i = 0; i < plan::size && success; i++)
+    {
+        // skip registers already read with the burst of an earlier one
+        bool done = false;
+        for (uint8_t j = 0; j < i; j++)
+            done = done || first[j] == first[i];
+        if (done)
+            continue;
+
+        uint16_t values[burstReadRegs];
+        success = readRegs(first[i], values, last[i] - first[i] + 1) != 0;
+        for (uint8_t k = i; k < plan::size; k++)
+        {
+            if (first[k] == first[i])
+                out[k] = values[regs[k] - first[i]];
+        }
+    }
+    endBurst();
+    return success;
+}
+
 #endif
 
 
@@ -0,0 +1,212 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* Ole Dreessen; ole.dreessen@maximintegrated.com
+* 
+**********************************************************************/
+
+#include <Arduino-MAX17055_GaugeCore.h>
+
+bool FuelGaugeCore::probe()
+{
+  uint32_t start = micros();
+  _wire->beginTransmission(_traits->address);
+  uint8_t error = _wire->endTransmission();
+  tally(1, start, error);
+  return error == 0;
+}
+
+uint16_t FuelGaugeCore::dumpAll(uint16_t out[256])
+{
+  uint8_t step = _traits->addressStep;
+  uint16_t bytes = 0;
+  uint16_t reg = 0;
+  while (reg < 256)
+  {
+    if (!isMapped(reg))
+    {
+      out[reg++] = 0;
+      continue;
+    }
+
+    // extend the range over short reserved holes, they are cheaper to read than a new transaction
+    uint16_t last = reg;
+    for (uint16_t next = reg + step; next < 256 && next - last <= (burstMaxGap + 1) * step; next += step)
+    {
+      if (isMapped(next))
+        last = next;
+    }
+
+    uint8_t count = (last - reg) / step + 1;
+    beginBurst();
+    bytes += readRegs(reg, &out[reg], count);
+    endBurst();
+    // byte addressed chips: spread the values to their addresses, from the end to not overwrite any
+    for (uint8_t i = count; step > 1 && i-- > 1;)
+      out[reg + i * step] = out[reg + i];
+    for (; reg <= last; reg++)
+    {
+      if (!isMapped(reg))
+        out[reg] = 0;
+    }
+  }
+  return bytes;
+}
+
+void FuelGaugeCore::writeReg16Bit(uint8_t reg, uint16_t value)
+{
+  MAX17055_PROFILE_BEGIN(OpWrite, reg);
+  beginWrite(reg);
+  writeWord(value);
+  endWrite();
+  MAX17055_PROFILE_END(OpWrite, reg);
+}
+
+uint16_t FuelGaugeCore::readReg16Bit(uint8_t reg)
+{
+  uint16_t value = 0;
+  readRegs(reg, &value, 1);
+  return value;
+}
+
+uint16_t FuelGaugeCore::readRegs(uint8_t reg, uint16_t* values, uint8_t count)
+{
+  //Burst read, the register address auto-increments after every word. Split into chunks fitting the Wire buffer
+  //Returns the bytes transferred, or 0 if the gauge returned less data than requested
+  MAX17055_PROFILE_BEGIN(OpRead, reg);
+#if MAX17055_PROFILE
+  uint8_t firstReg = reg;
+#endif
+  bool burst = count > 1;
+  if (burst)
+    beginBurst();
+  uint16_t bytes = 0;
+  while (count > 0)
+  {
+    uint32_t start = micros();
+    uint8_t chunk = count > burstReadRegs ? burstReadRegs : count;
+    _wire->beginTransmission(_traits->address);
+    _wire->write(reg);
+    uint8_t error = _wire->endTransmission(false);
+
+    if (_wire->requestFrom(_traits->address, (uint8_t) (chunk * 2)) != chunk * 2)
+    {
+      tally(2, start, error != 0 ? error : 0xFF);
+      memset(values, 0, count * sizeof(uint16_t));
+      bytes = 0;
+      break;
+    }
+    for (uint8_t i = 0; i < chunk; i++)
+    {
+      uint16_t first = _wire->read();
+      uint16_t second = _wire->read();
+      values[i] = _traits->msbFirst ? (first << 8) | second : (second << 8) | first;
+    }
+    bytes += 2 + 1 + chunk * 2; // address + register, then address + data
+    tally(2 + 1 + chunk * 2, start, error);
+
+    reg += chunk * _traits->addressStep;
+    values += chunk;
+    count -= chunk;
+  }
+  if (burst)
+    endBurst();
+  MAX17055_PROFILE_END(OpRead, firstReg);
+  return bytes;
+}
+
+void FuelGaugeCore::beginWrite(uint8_t reg)
+{
+  _writeStart = micros();
+  _writeBytes = 2;
+  _wire->beginTransmission(_traits->address);
+  _wire->write(reg);
+}
+
+void FuelGaugeCore::writeWord(uint16_t value)
+{
+  //The m5 gauges take the LSB first, and then the MSB. Refer to AN635 pg 35 figure 1.12.2.5
+  uint8_t low = value & 0xFF;
+  uint8_t high = (value >> 8) & 0xFF;
+  _wire->write(_traits->msbFirst ? high : low);
+  _wire->write(_traits->msbFirst ? low : high);
+  _writeBytes += 2;
+}
+
+bool FuelGaugeCore::endWrite()
+{
+  uint8_t error = _wire->endTransmission();
+  tally(_writeBytes, _writeStart, error);
+  return error == 0;
+}
+
+void FuelGaugeCore::setBurstClock(uint32_t clockHz, uint32_t restoreHz)
+{
+  _burstClock = clockHz;
+  _restoreClock = restoreHz;
+}
+
+void FuelGaugeCore::beginBurst()
+{
+  if (_clockDepth++ > 0 || _burstClock == 0)
+    return;
+#if MAX17055_WIRE_GETCLOCK
+  _restoreClock = _wire->getClock();
+#endif
+  if (_restoreClock != _burstClock)
+    _wire->setClock(_burstClock);
+}
+
+void FuelGaugeCore::endBurst()
+{
+  if (--_clockDepth > 0 || _burstClock == 0 || _restoreClock == _burstClock)
+    return;
+  _wire->setClock(_restoreClock);
+}
+
+void FuelGaugeCore::tally(uint16_t bytes, uint32_t startMicros, uint8_t error)
+{
+  uint32_t duration = micros() - startMicros;
+  _throughput.bytes += bytes;
+  _throughput.micros += duration;
+  _throughput.transactions++;
+  if (duration > _health.maxLatency)
+    _health.maxLatency = duration;
+
+  switch (error)
+  {
+    case 0:
+      if (_busFailed)
+        _health.recoveries++;
+      _busFailed = false;
+      return;
+    case 2:    _health.nackAddress++; break;
+    case 3:    _health.nackData++;    break;
+    case 0xFF: _health.shortReads++;  break;
+    default:   _health.otherErrors++; break;
+  }
+  _busFailed = true;
+}
@@ -0,0 +1,206 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* Ole Dreessen; ole.dreessen@maximintegrated.com
+* 
+**********************************************************************/
+
+#ifndef Arduino_MAX17055_GaugeCore_h
+#define Arduino_MAX17055_GaugeCore_h
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// Size of the Wire library buffer, limits how many registers fit into one burst transfer.
+// AVR defines BUFFER_LENGTH (32 bytes), ESP32 and others define I2C_BUFFER_LENGTH.
+#ifndef MAX17055_WIRE_BUFFER_SIZE
+  #if defined(I2C_BUFFER_LENGTH)
+    #define MAX17055_WIRE_BUFFER_SIZE I2C_BUFFER_LENGTH
+  #elif defined(BUFFER_LENGTH)
+    #define MAX17055_WIRE_BUFFER_SIZE BUFFER_LENGTH
+  #else
+    #define MAX17055_WIRE_BUFFER_SIZE 32
+  #endif
+#endif
+
+// Wire can tell its clock on ESP32, elsewhere the clock to restore after bursts has to be given
+#ifndef MAX17055_WIRE_GETCLOCK
+  #if defined(ARDUINO_ARCH_ESP32)
+    #define MAX17055_WIRE_GETCLOCK 1
+  #else
+    #define MAX17055_WIRE_GETCLOCK 0
+  #endif
+#endif
+
+// Profiling hooks called at the start and end of every driver operation, e.g. to toggle a GPIO or
+// read the DWT cycle counter. Set MAX17055_PROFILE to 1 in the build flags and define the two
+// functions in the sketch. Without it the hooks compile to nothing. The macro only changes code in
+// the library's .cpp files, never the layout of a class
+#ifndef MAX17055_PROFILE
+  #define MAX17055_PROFILE 0
+#endif
+#if MAX17055_PROFILE
+  // op is one of FuelGaugeCore::profileOp, reg the register or 0
+  void max17055ProfileBegin(uint8_t op, uint8_t reg);
+  void max17055ProfileEnd(uint8_t op, uint8_t reg);
+  #define MAX17055_PROFILE_BEGIN(op, reg) max17055ProfileBegin(op, reg)
+  #define MAX17055_PROFILE_END(op, reg) max17055ProfileEnd(op, reg)
+#else
+  #define MAX17055_PROFILE_BEGIN(op, reg) do {} while (0)
+  #define MAX17055_PROFILE_END(op, reg) do {} while (0)
+#endif
+
+// Chip specific constants of a Maxim fuel gauge, one instance per chip below
+struct GaugeTraits
+{
+  uint8_t address;          // 7 bit I2C address
+  bool msbFirst;            // byte order of the 16 bit registers, the ModelGauge m5 gauges send the low byte first
+  uint8_t addressStep;      // register address increment per 16 bit register, 2 if the chip counts bytes
+  bool ezConfig;            // configured through ModelCfg with ModelGauge m5 EZ, see MAX17055::init()
+  // LSBs of the standard register formats, 0 if the chip doesn't have them
+  float capacityLSB;        // mAh with a 1 ohm sense resistor
+  float currentLSB;         // mA with a 1 ohm sense resistor
+  float voltageLSB;         // V
+  float percentLSB;         // %
+  float timeLSB;            // h
+  uint8_t registerMap[32];  // one bit per register address, reserved locations are 0
+};
+
+// ModelGauge m5 EZ, reserved locations of the memory map (datasheet table 16) are 0
+constexpr GaugeTraits MAX17055Traits = {
+  0x36, false, 1, true, 5e-3f, 1.5625e-3f, 7.8125e-5f, 1.0f / 256.0f, 5.625f / 3600.0f,
+  { 0xFF, 0xFF, 0xDF, 0xFF, 0x8F, 0xFF, 0x34, 0xE7, 0x6D, 0x26, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x7F, 0x00, 0x00, 0xFB, 0xFF, 0x00, 0x00, 0x00, 0x80 }
+};
+// ModelGauge m5 EZ with the register layout of the MAX17055
+constexpr GaugeTraits MAX17260Traits = MAX17055Traits;
+// ModelGauge m5, configured from its nonvolatile memory. Only the volatile page 0x000-0x0FF is
+// covered, the nonvolatile page is at another I2C address. Reserved locations aren't masked
+constexpr GaugeTraits MAX17201Traits = {
+  0x36, false, 1, false, 5e-3f, 1.5625e-3f, 7.8125e-5f, 1.0f / 256.0f, 5.625f / 3600.0f,
+  { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00 }
+};
+// ModelGauge, voltage based without sense resistor. Registers are big endian at even byte addresses
+constexpr GaugeTraits MAX17048Traits = {
+  0x36, true, 2, false, 0.0f, 0.0f, 7.8125e-5f, 1.0f / 256.0f, 0.0f,
+  { 0x54, 0x15, 0x50, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
+};
+
+// I2C register engine shared by the gauge drivers. Single and burst transfers sized to the Wire
+// buffer, in the byte order and with the register map of the chip given by its traits
+class FuelGaugeCore
+{
+  public:
+    // operations reported to the profiling hooks
+    enum profileOp
+    {
+      OpRead     = 0, // burst or single register read, reg is the first register
+      OpWrite    = 1, // burst or single register write, reg is the first register
+      OpInit     = 2, // MAX17055::init()
+      OpJob      = 3, // one MAX17055::runJob() step, reg is the job type
+      OpSnapshot = 4, // MAX17055::readSnapshot()
+      OpBatch    = 5, // MAX17055::writeBatch()
+      OpRestore  = 6, // MAX17055::restoreLearnedParameters()
+    };
+
+    const GaugeTraits& traits() const { return *_traits; }
+    bool isMapped(uint8_t reg) const { return _traits->registerMap[reg >> 3] & (1 << (reg & 7)); }
+    // true if the gauge acknowledges its address
+    bool probe();
+
+    // reads the whole register space into out (256 entries), reserved addresses read as 0
+    // returns the number of bytes transferred on the bus
+    uint16_t dumpAll(uint16_t out[256]);
+
+    // Runs burst transfers at clockHz (the gauges support up to 400kHz) and sets the clock back
+    // afterwards, to the clock Wire reports where it can (ESP32), else to restoreHz. 0 turns it off
+    void setBurstClock(uint32_t clockHz, uint32_t restoreHz = 100000);
+
+    // bus traffic of the driver, counted from the last resetThroughput()
+    struct Throughput
+    {
+      uint32_t bytes;
+      uint32_t micros;        // time spent in transfers
+      uint32_t transactions;
+      uint32_t bytesPerSecond() const { return micros ? (uint32_t) ((uint64_t) bytes * 1000000UL / micros) : 0; }
+    };
+    const Throughput& throughput() const { return _throughput; }
+    void resetThroughput() { _throughput = Throughput(); }
+
+    // error counters of the bus to this gauge, to notice a marginal connection before the values go bad
+    struct BusHealth
+    {
+      uint16_t nackAddress;   // gauge didn't acknowledge its address
+      uint16_t nackData;      // gauge didn't acknowledge a byte
+      uint16_t otherErrors;   // other Wire errors, e.g. lost arbitration or timeout
+      uint16_t shortReads;    // less data received than requested
+      uint16_t retries;       // writes repeated after a failed verification
+      uint16_t recoveries;    // transactions that succeeded after a failed one
+      uint32_t maxLatency;    // micros of the longest transaction
+    };
+    const BusHealth& busHealth() const { return _health; }
+    void resetBusHealth() { _health = BusHealth(); }
+
+  protected:
+    constexpr FuelGaugeCore(const GaugeTraits& traits) : _traits(&traits) {}
+
+    const GaugeTraits* _traits;
+    TwoWire *_wire = &Wire;
+    uint32_t _burstClock = 0;
+    uint32_t _restoreClock = 100000;
+    uint8_t _clockDepth = 0;
+    uint8_t _writeBytes = 0;
+    uint32_t _writeStart = 0;
+    Throughput _throughput = {0, 0, 0};
+    BusHealth _health = {0, 0, 0, 0, 0, 0, 0};
+    bool _busFailed = false;
+
+    // registers per burst read, limited by the Wire buffer and the 8 bit length of requestFrom()
+    static const uint8_t burstReadRegs = (MAX17055_WIRE_BUFFER_SIZE > 254 ? 254 : MAX17055_WIRE_BUFFER_SIZE) / 2;
+    // reading up to this many unneeded registers is cheaper than starting another transaction
+    static const uint8_t burstMaxGap = 2;
+    // registers per burst write, one byte of the buffer is taken by the register address
+    static const uint8_t burstWriteRegs = ((MAX17055_WIRE_BUFFER_SIZE > 255 ? 255 : MAX17055_WIRE_BUFFER_SIZE) - 1) / 2;
+
+    uint16_t readReg16Bit(uint8_t reg);
+    void writeReg16Bit(uint8_t reg, uint16_t value);
+    // burst read, returns the bytes transferred or 0 if the gauge returned less data than requested
+    uint16_t readRegs(uint8_t reg, uint16_t* values, uint8_t count);
+    // burst write of up to burstWriteRegs registers: beginWrite(), writeWord() per register, then
+    // endWrite() which returns false on a bus error. Callers wrap them in the OpWrite profiling hooks
+    void beginWrite(uint8_t reg);
+    void writeWord(uint16_t value);
+    bool endWrite();
+    // raise the clock for the transfers in between, calls can be nested
+    void beginBurst();
+    void endBurst();
+    // counts a transaction, error is the result of endTransmission() or 0xFF for a short read
+    void tally(uint16_t bytes, uint32_t startMicros, uint8_t error);
+};
+
+#endif
@@ -0,0 +1,85 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* Ole Dreessen; ole.dreessen@maximintegrated.com
+* 
+**********************************************************************/
+
+#include <Arduino-MAX17055_MAX17048.h>
+
+bool MAX17048::begin(TwoWire *theWire)
+{
+    _wire = theWire;
+    return probe();
+}
+
+float MAX17048::getInstantaneousVoltage()
+{
+    uint16_t voltage_raw = readReg16Bit(VCell);
+    return voltage_raw * _traits->voltageLSB;
+}
+
+float MAX17048::getSOC()
+{
+    uint16_t SOC_raw = readReg16Bit(SOC);
+    return SOC_raw * _traits->percentLSB;
+}
+
+float MAX17048::getChargeRate()
+{
+    int16_t rate_raw = readReg16Bit(CRate);
+    return rate_raw * 0.208f; // LSB is 0.208%/h
+}
+
+uint16_t MAX17048::getVersion()
+{
+    return readReg16Bit(Version);
+}
+
+bool MAX17048::readVoltageSOC(uint16_t& vCell, uint16_t& soc)
+{
+    uint16_t values[2];
+    bool success = readRegs(VCell, values, 2) != 0;
+    vCell = values[0];
+    soc = values[1];
+    return success;
+}
+
+bool MAX17048::getPOR()
+{
+    return readReg16Bit(Status) & 0x0100; // RI bit
+}
+
+void MAX17048::resetPOR()
+{
+    uint16_t status = readReg16Bit(Status);
+    writeReg16Bit(Status, status & ~0x0100);
+}
+
+void MAX17048::quickStart()
+{
+    writeReg16Bit(Mode, 0x4000);
+}
@@ -0,0 +1,78 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* Ole Dreessen; ole.dreessen@maximintegrated.com
+* 
+**********************************************************************/
+
+#ifndef Arduino_MAX17055_MAX17048_h
+#define Arduino_MAX17055_MAX17048_h
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <Arduino-MAX17055_GaugeCore.h>
+
+// Driver of the MAX17048 ModelGauge fuel gauge on the shared FuelGaugeCore. The gauge works
+// without sense resistor and needs no configuration, it estimates the SOC from VCell only
+class MAX17048 : public FuelGaugeCore
+{
+  public:
+    // register addresses, the registers are at even byte addresses
+    enum regAddr
+    {
+      VCell   = 0x02, // cell voltage
+      SOC     = 0x04, // state of charge
+      Mode    = 0x06, // quick-start, sleep and hibernate control
+      Version = 0x08, // production version
+      Hibrt   = 0x0A, // hibernation thresholds
+      Config  = 0x0C, // compensation, alert and sleep
+      VAlrt   = 0x14, // voltage alert thresholds
+      CRate   = 0x16, // charge or discharge rate
+      VReset  = 0x18, // reset voltage and ID
+      Status  = 0x1A, // alert flags
+      Cmd     = 0xFE, // power-on reset when writing 0x5400
+    };
+
+    constexpr MAX17048() : FuelGaugeCore(MAX17048Traits) {}
+
+    // returns false if the gauge doesn't respond
+    bool begin(TwoWire *theWire = &Wire);
+
+    float getInstantaneousVoltage();  // V
+    float getSOC();                   // %
+    float getChargeRate();            // %/h, +ve is charging, -ve is discharging
+    uint16_t getVersion();
+    // VCell and SOC raw with one burst read, returns false on a bus error
+    bool readVoltageSOC(uint16_t& vCell, uint16_t& soc);
+
+    // reset indicator, set after a power-on reset until cleared
+    bool getPOR();
+    void resetPOR();
+    // restarts the SOC estimation from the current VCell, e.g. after the battery was swapped
+    void quickStart();
+};
+
+#endif
@@ -0,0 +1,92 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* Ole Dreessen; ole.dreessen@maximintegrated.com
+* 
+**********************************************************************/
+
+#include <Arduino-MAX17055_Pack.h>
+
+MAX17055Pack::MAX17055Pack(MAX17055* const* gauges, uint8_t count, topology topo)
+  : _gauges(gauges), _count(count), _topology(topo)
+{
+    memset(&_state, 0, sizeof(_state));
+}
+
+bool MAX17055Pack::update(State& state)
+{
+    State pack;
+    memset(&pack, 0, sizeof(pack));
+    float minSOC = 0;
+
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        MAX17055& gauge = *_gauges[i];
+        MAX17055::Snapshot snap;
+        if (!gauge.readSnapshot(snap))
+            continue;
+
+        float repCap = gauge.toCapacity(snap.repCap);
+        float fullCapRep = gauge.toCapacity(snap.fullCapRep);
+        float soc = gauge.toPercentage(snap.repSOC);
+        float tte = gauge.toHours(snap.timeToEmpty);
+        bool first = pack.gauges == 0;
+
+        pack.tte = first ? tte : min(pack.tte, tte);
+        pack.current += gauge.toCurrent(snap.current);
+        pack.voltage += gauge.toVoltage(snap.vCell);
+        if (_topology == Parallel)
+        {
+            pack.repCap += repCap;
+            pack.fullCapRep += fullCapRep;
+        }
+        else
+        {
+            pack.repCap = first ? repCap : min(pack.repCap, repCap);
+            pack.fullCapRep = first ? fullCapRep : min(pack.fullCapRep, fullCapRep);
+            minSOC = first ? soc : min(minSOC, soc);
+        }
+        pack.gauges++;
+    }
+
+    if (pack.gauges > 0)
+    {
+        if (_topology == Parallel)
+        {
+            pack.soc = pack.fullCapRep > 0 ? pack.repCap / pack.fullCapRep * 100.0f : 0;
+            pack.voltage /= pack.gauges;
+        }
+        else
+        {
+            pack.soc = minSOC;
+            pack.current /= pack.gauges;
+        }
+    }
+
+    _state = pack;
+    state = pack;
+    return pack.gauges == _count;
+}
@@ -0,0 +1,83 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* Ole Dreessen; ole.dreessen@maximintegrated.com
+* 
+**********************************************************************/
+
+#ifndef Arduino_MAX17055_Pack_h 
+#define Arduino_MAX17055_Pack_h 
+
+#include <Arduino-MAX17055_Driver.h>
+
+/**********************************************************************
+* @brief MAX17055Pack - Combines the readings of several MAX17055, each monitoring one
+* cell or parallel string of a battery pack, into pack values. Every gauge is read with one
+* snapshot per update and the pack values are accumulated while the snapshots come in.
+*
+* Parallel strings: the pack SOC is weighted by capacity (sum of RepCap / sum of FullCapRep),
+* capacities and currents add up, the voltage is the average.
+* Series cells: the weakest cell limits the pack, SOC and capacities are the minimum,
+* the current is the average and the voltages add up.
+* In both cases the time to empty is the one of the gauge running empty first.
+**********************************************************************/
+
+class MAX17055Pack
+{
+  public:
+    enum topology
+    {
+      Parallel = 0,
+      Series   = 1,
+    };
+
+    struct State
+    {
+      float soc;        // %
+      float repCap;     // mAh
+      float fullCapRep; // mAh
+      float tte;        // h, minimum of all gauges
+      float current;    // mA, +ve current is charging, -ve is discharging
+      float voltage;    // V
+      uint8_t gauges;   // number of gauges that could be read
+    };
+
+    MAX17055Pack(MAX17055* const* gauges, uint8_t count, topology topo = Parallel);
+
+    // reads one snapshot of every gauge, returns false if any gauge failed to respond
+    // the state then only contains the gauges that could be read
+    bool update(State& state);
+    // pack values of the snapshots taken last by update()
+    const State& state() const { return _state; }
+
+  private:
+    MAX17055* const* _gauges;
+    uint8_t _count;
+    topology _topology;
+    State _state;
+};
+
+#endif
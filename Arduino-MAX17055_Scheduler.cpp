@@ -0,0 +1,218 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* Ole Dreessen; ole.dreessen@maximintegrated.com
+* 
+**********************************************************************/
+
+#include <Arduino-MAX17055_Scheduler.h>
+
+MAX17055Scheduler::MAX17055Scheduler()
+  : _alert(false)
+{
+    memset(_tasks, 0, sizeof(_tasks));
+}
+
+int8_t MAX17055Scheduler::add(operation op, void* context, uint32_t periodMs, uint32_t deadlineMs, priority prio,
+                              uint32_t costMicros, uint32_t firstMs)
+{
+    for (uint8_t i = 0; i < MAX17055_SCHEDULER_TASKS; i++)
+    {
+        if (_tasks[i].used)
+            continue;
+
+        task& t = _tasks[i];
+        memset(&t, 0, sizeof(t));
+        t.op = op;
+        t.context = context;
+        t.periodMs = periodMs;
+        t.deadlineMs = deadlineMs;
+        t.costMicros = costMicros;
+        t.releaseMs = firstMs;
+        t.prio = prio;
+        t.used = true;
+        return i;
+    }
+    return -1;
+}
+
+int8_t MAX17055Scheduler::addAlert(operation op, void* context, uint32_t deadlineMs, priority prio, uint32_t costMicros)
+{
+    int8_t id = add(op, context, 0, deadlineMs, prio, costMicros, 0);
+    if (id >= 0)
+        _tasks[id].alert = true;
+    return id;
+}
+
+void MAX17055Scheduler::remove(int8_t id)
+{
+    if (id >= 0 && id < MAX17055_SCHEDULER_TASKS)
+        _tasks[id].used = false;
+}
+
+uint8_t MAX17055Scheduler::poll(uint32_t budgetMicros)
+{
+    uint8_t calls = 0;
+    uint32_t spent = 0;
+    // tasks passed over in this call, because of the budget or higher class deadlines, or already called.
+    // A task whose period is shorter than its execution time is released again at once, calling every
+    // task at most once keeps the call bounded
+    uint32_t skipped = 0;
+
+    while (true)
+    {
+        uint32_t now = millis();
+        release(now);
+
+        // earliest deadline among the ready tasks, the higher class wins ties
+        int8_t next = -1;
+        for (uint8_t i = 0; i < MAX17055_SCHEDULER_TASKS; i++)
+        {
+            const task& t = _tasks[i];
+            if (!t.used || !t.ready || (skipped & (1UL << i)) || (int32_t) (now - t.resumeMs) < 0)
+                continue;
+            if (next < 0 || (int32_t) (t.dueMs - _tasks[next].dueMs) < 0 ||
+                (t.dueMs == _tasks[next].dueMs && t.prio < _tasks[next].prio))
+                next = i;
+        }
+        if (next < 0)
+            break;
+
+        task& t = _tasks[next];
+        if ((t.prio != Control && spent > 0 && spent + t.costMicros > budgetMicros) || !admissible(t, now))
+        {
+            skipped |= 1UL << next;
+            if (!t.late && (int32_t) (now - t.dueMs) > 0)
+            {
+                t.late = true;
+                t.missed++;
+            }
+            continue;
+        }
+
+        uint32_t waitMs = 0;
+        bool done = t.op(t.context, waitMs);
+        spent += t.costMicros;
+        calls++;
+        skipped |= 1UL << next;
+
+        now = millis();
+        if (done)
+        {
+            t.ready = false;
+            if (!t.late && (int32_t) (now - t.dueMs) > 0)
+                t.missed++;
+            if (t.periodMs == 0 && !t.alert)
+                t.used = false;
+        }
+        else
+        {
+            t.resumeMs = now + waitMs;
+        }
+    }
+    return calls;
+}
+
+bool MAX17055Scheduler::gaugeJob(void* gauge, uint32_t& waitMs)
+{
+    // a warm boot init is done before its settings check, keep stepping until that is done too
+    MAX17055* max17055 = static_cast<MAX17055*>(gauge);
+    return max17055->runJob(waitMs) != MAX17055::JobPending && !max17055->jobPending();
+}
+
+uint32_t MAX17055Scheduler::nextDeadline() const
+{
+    uint32_t now = millis();
+    if (_alert)
+        return now;
+
+    int32_t earliest = 0x7FFFFFFF;
+    for (uint8_t i = 0; i < MAX17055_SCHEDULER_TASKS; i++)
+    {
+        const task& t = _tasks[i];
+        if (!t.used || (t.alert && !t.ready))
+            continue;
+        int32_t in = (int32_t) ((t.ready ? t.resumeMs : t.releaseMs) - now);
+        if (in < earliest)
+            earliest = in;
+    }
+    return earliest > 0 ? now + earliest : now;
+}
+
+void MAX17055Scheduler::release(uint32_t now)
+{
+    // an alert while an alert task is still ready or running releases it again once it's done
+    bool busy = false;
+    for (uint8_t i = 0; i < MAX17055_SCHEDULER_TASKS; i++)
+        busy = busy || (_tasks[i].used && _tasks[i].alert && _tasks[i].ready);
+    noInterrupts();
+    bool alert = _alert && !busy;
+    if (alert)
+        _alert = false;
+    interrupts();
+    for (uint8_t i = 0; i < MAX17055_SCHEDULER_TASKS; i++)
+    {
+        task& t = _tasks[i];
+        if (t.used && t.alert && !t.ready && alert)
+        {
+            t.ready = true;
+            t.late = false;
+            t.dueMs = now + t.deadlineMs;
+            t.resumeMs = now;
+            continue;
+        }
+        if (!t.used || t.ready || t.alert || (int32_t) (now - t.releaseMs) < 0)
+            continue;
+
+        t.ready = true;
+        t.late = false;
+        t.dueMs = t.releaseMs + t.deadlineMs;
+        t.resumeMs = t.releaseMs;
+        // a run that was late doesn't cause a burst of catch up runs
+        do
+        {
+            t.releaseMs += t.periodMs;
+        } while (t.periodMs > 0 && (int32_t) (now - t.releaseMs) >= 0);
+    }
+}
+
+bool MAX17055Scheduler::admissible(const task& t, uint32_t now) const
+{
+    // running t must leave every task of a higher class enough time before its next deadline
+    uint32_t end = now + (t.costMicros + 999) / 1000;
+    for (uint8_t i = 0; i < MAX17055_SCHEDULER_TASKS; i++)
+    {
+        const task& other = _tasks[i];
+        if (!other.used || other.prio >= t.prio || (other.alert && !other.ready))
+            continue;
+
+        uint32_t due = other.ready ? other.dueMs : other.releaseMs + other.deadlineMs;
+        uint32_t latestStart = due - (other.costMicros + 999) / 1000;
+        if ((int32_t) (end - latestStart) > 0)
+            return false;
+    }
+    return true;
+}
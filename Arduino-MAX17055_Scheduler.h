@@ -0,0 +1,123 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* Ole Dreessen; ole.dreessen@maximintegrated.com
+* 
+**********************************************************************/
+
+#ifndef Arduino_MAX17055_Scheduler_h 
+#define Arduino_MAX17055_Scheduler_h 
+
+#include <Arduino-MAX17055_Driver.h>
+
+// Number of tasks a MAX17055Scheduler can hold
+#ifndef MAX17055_SCHEDULER_TASKS
+  #define MAX17055_SCHEDULER_TASKS 8
+#endif
+#if MAX17055_SCHEDULER_TASKS > 32
+  #error "MAX17055Scheduler supports up to 32 tasks"
+#endif
+
+/**********************************************************************
+* @brief MAX17055Scheduler - Earliest deadline first scheduling of gauge operations from one loop.
+* Each task is an operation with a period, a deadline relative to its release, a priority class
+* and the bus time one call of it takes (e.g. from MAX17055::CostModel). Operations are called
+* without preemption, so a task of a lower class (higher number) is only started if it can't
+* make any task of a higher class miss its next deadline. Control reads therefore keep their
+* deadlines while health reads or a restore of learned parameters are pending, as long as every
+* call of an operation is short. Multi-step operations like MAX17055::runJob() return after each
+* step and tell when to call them again, see gaugeJob().
+* poll() runs ready operations until the bus time budget of the call is used up, each at most once
+* per call. The Control class isn't limited by the budget, and the first operation of a call always
+* runs, so an operation that costs more than the budget still gets its turn.
+* Between the polls the MCU can sleep until nextDeadline(), or until the ALRT pin of the gauge
+* wakes it. The pin interrupt calls notifyAlert(), which releases the alert tasks.
+**********************************************************************/
+
+class MAX17055Scheduler
+{
+  public:
+    enum priority
+    {
+      Control = 0, // e.g. Current every 200ms
+      Medium  = 1, // e.g. SOC every few seconds
+      Health  = 2, // e.g. learned parameters every hour
+    };
+
+    // Called when a task is due. Returns true when the operation finished, false if it needs to be
+    // called again after waitMs
+    typedef bool (*operation)(void* context, uint32_t& waitMs);
+
+    MAX17055Scheduler();
+
+    // adds a task first released at firstMs, periodMs 0 runs it once. Returns the task id or -1 if full
+    int8_t add(operation op, void* context, uint32_t periodMs, uint32_t deadlineMs, priority prio,
+               uint32_t costMicros, uint32_t firstMs);
+    // adds a task released by every notifyAlert() instead of by time
+    int8_t addAlert(operation op, void* context, uint32_t deadlineMs, priority prio, uint32_t costMicros);
+    void remove(int8_t id);
+
+    // safe to call from an interrupt, e.g. of the ALRT pin
+    void notifyAlert() { _alert = true; }
+    // millis() time at which poll() has the next operation to run, now if one is ready. Without any
+    // timed task it's the longest time ahead millis() can express, the MCU can sleep until an alert
+    uint32_t nextDeadline() const;
+
+    // runs due operations, returns how many calls were made, at most one per task
+    uint8_t poll(uint32_t budgetMicros);
+    // runs that passed their deadline, while passed over or before completing, per task
+    uint16_t missed(int8_t id) const { return id >= 0 && id < MAX17055_SCHEDULER_TASKS ? _tasks[id].missed : 0; }
+
+    // operation for add() stepping the job of the MAX17055 passed as context,
+    // e.g. after beginRestoreLearnedParameters()
+    static bool gaugeJob(void* gauge, uint32_t& waitMs);
+
+  private:
+    struct task
+    {
+      operation op;
+      void* context;
+      uint32_t periodMs;
+      uint32_t deadlineMs;
+      uint32_t costMicros;
+      uint32_t releaseMs; // next release
+      uint32_t dueMs;     // deadline of the current run
+      uint32_t resumeMs;  // a running multi-step operation continues at
+      uint16_t missed;
+      uint8_t prio;
+      bool used;
+      bool ready;
+      bool alert;         // released by notifyAlert()
+      bool late;          // the current run is counted in missed
+    };
+    task _tasks[MAX17055_SCHEDULER_TASKS];
+    volatile bool _alert;
+
+    void release(uint32_t now);
+    bool admissible(const task& t, uint32_t now) const;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* 
+**********************************************************************/
+
+// Sleeps between the gauge reads until the next one is due or the ALRT pin of the gauge
+// (open drain, active low) signals a low battery
+
+#include <Arduino-MAX17055_Scheduler.h>
+#include <Wire.h>
+
+const uint8_t alertPin = 2;
+
+MAX17055 sensor(MAX17055::Config().capacity(4500));
+MAX17055Scheduler scheduler;
+
+void onAlert() {
+  scheduler.notifyAlert();
+}
+
+bool readGauge(void* gauge, uint32_t&) {
+  MAX17055::Snapshot snap;
+  if (static_cast<MAX17055*>(gauge)->readSnapshot(snap)) {
+    Serial.print("SOC ");
+    Serial.print(sensor.toPercentage(snap.repSOC));
+    Serial.println(" %");
+  }
+  return true;
+}
+
+bool handleAlert(void* gauge, uint32_t&) {
+  MAX17055* g = static_cast<MAX17055*>(gauge);
+  if (g->getAlerts() & MAX17055::alertSOCLow)
+    Serial.println("Battery low");
+  g->clearAlerts();
+  return true;
+}
+
+// replace with the sleep mode of the MCU, waking up by the timer or the pin interrupt
+void sleepFor(uint32_t ms) {
+  Serial.flush();
+  delay(ms);
+}
+
+void setup() {
+  Wire.begin();
+  Serial.begin(9600);
+  if (!sensor.begin())
+    Serial.println("MAX17055 not found");
+
+  sensor.setSOCAlert(10, 255);
+  sensor.clearAlerts();
+  sensor.enableAlerts(true);
+  pinMode(alertPin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(alertPin), onAlert, FALLING);
+
+  uint32_t cost = MAX17055::CostModel::snapshot(100000).micros;
+  scheduler.add(readGauge, &sensor, 60000, 1000, MAX17055Scheduler::Medium, cost, millis());
+  scheduler.addAlert(handleAlert, &sensor, 100, MAX17055Scheduler::Control, 2 * cost);
+}
+
+void loop() {
+  scheduler.poll(10000);
+  int32_t sleepMs = (int32_t) (scheduler.nextDeadline() - millis());
+  if (sleepMs > 0)
+    sleepFor(sleepMs);
+}
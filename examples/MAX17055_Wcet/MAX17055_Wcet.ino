@@ -0,0 +1,161 @@
+/**********************************************************************
+*
+* MIT License
+*
+* Copyright (c) 2018 Awot Ghirmai
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+* 
+* Authors: 
+* Awot Ghirmai; ghirmai.awot@gmail.com
+* 
+**********************************************************************/
+
+// Measures the longest time and the most bus transactions of every driver call on the target,
+// for the worst case execution time next to the static bounds of the driver. The times of the single
+// operations need the library built with -DMAX17055_PROFILE=1, e.g. in the build_flags of PlatformIO
+// or the extra flags of arduino-cli. Without it only whole calls are measured.
+// Lowering the I2C clock below shows the calls on a slow bus.
+// The sketch doesn't reconfigure the gauge or overwrite what it learned, as long as the Config below
+// is the one the gauge runs with. The configuring and restoring paths with an injected bus latency are
+// measured on the host, see extras/test/test_wcet.cpp
+
+#include <Arduino-MAX17055_Driver.h>
+#include <Wire.h>
+
+const MAX17055::Config config = MAX17055::Config().capacity(4500);
+MAX17055 sensor(config);
+
+#if MAX17055_PROFILE
+// per FuelGaugeCore::profileOp, measured by the profiling hooks
+const uint8_t opCount = 7;
+const char* const opNames[opCount] = {"read", "write", "init", "runJob", "readSnapshot", "writeBatch", "restore"};
+uint8_t opDepth[opCount];
+uint32_t opStart[opCount];
+uint32_t opStartTx[opCount];
+uint32_t opMicros[opCount];
+uint32_t opTx[opCount];
+
+void max17055ProfileBegin(uint8_t op, uint8_t) {
+  if (op >= opCount || opDepth[op]++ > 0)
+    return;
+  opStartTx[op] = sensor.throughput().transactions;
+  opStart[op] = micros();
+}
+
+void max17055ProfileEnd(uint8_t op, uint8_t) {
+  if (op >= opCount || --opDepth[op] > 0)
+    return;
+  uint32_t elapsed = micros() - opStart[op];
+  opMicros[op] = max(opMicros[op], elapsed);
+  opTx[op] = max(opTx[op], sensor.throughput().transactions - opStartTx[op]);
+}
+#endif
+
+// calls that aren't profiled themselves
+uint32_t callStartTx;
+uint32_t callStart;
+void startCall() {
+  callStartTx = sensor.throughput().transactions;
+  callStart = micros();
+}
+void endCall(const char* name) {
+  uint32_t elapsed = micros() - callStart;
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(elapsed);
+  Serial.print(" us, ");
+  Serial.print(sensor.throughput().transactions - callStartTx);
+  Serial.println(" transactions");
+}
+
+void setup() {
+  Wire.begin();
+  // Wire.setClock(10000);
+  Serial.begin(9600);
+  while (!Serial) {
+    delay(1);
+  }
+#if !MAX17055_PROFILE
+  Serial.println("Profiling is off, only whole calls are measured. Build the library with -DMAX17055_PROFILE=1");
+  Serial.println("for the times of the single operations");
+#endif
+
+  bool por;
+  startCall();
+  sensor.begin(por);
+  endCall("begin");
+
+  startCall();
+  sensor.beginInit(config);
+  uint32_t waitMs;
+  while (sensor.runJob(waitMs) == MAX17055::JobPending)
+    delay(waitMs);
+  endCall("beginInit, warm boot and settings check");
+
+  MAX17055::LearnedParams params;
+  startCall();
+  sensor.getLearnedParameters(params);
+  endCall("learned parameters save");
+
+  startCall();
+  if (sensor.getAlerts() != 0)
+    sensor.clearAlerts();
+  endCall("alert handling");
+
+  startCall();
+  sensor.sampleCurrent(8);
+  endCall("sampleCurrent(8)");
+
+  Serial.println();
+  Serial.println("Static bounds");
+  Serial.print("init runJob() calls: ");
+  Serial.println(MAX17055::maxInitJobCalls());
+  Serial.print("init waits ms: ");
+  Serial.println(MAX17055::maxInitWaitMs());
+  Serial.print("init transactions: ");
+  Serial.println(MAX17055::CostModel::initWorst(100000).transactions);
+  Serial.print("sampleCurrent(8) reads: ");
+  Serial.println(MAX17055::maxSampleReads(8));
+}
+
+void loop() {
+  for (uint16_t i = 0; i < 1000; i++) {
+    MAX17055::Snapshot snap;
+    sensor.readSnapshot(snap);
+    MAX17055::SocSet socs;
+    sensor.readSocSet(socs);
+  }
+
+  Serial.println();
+#if MAX17055_PROFILE
+  Serial.println("Longest operations so far");
+  for (uint8_t op = 0; op < opCount; op++) {
+    Serial.print(opNames[op]);
+    Serial.print(": ");
+    Serial.print(opMicros[op]);
+    Serial.print(" us, ");
+    Serial.print(opTx[op]);
+    Serial.println(" transactions");
+  }
+#endif
+  Serial.print("longest transaction: ");
+  Serial.print(sensor.busHealth().maxLatency);
+  Serial.println(" us");
+}
@@ -0,0 +1,27 @@
+// Arduino API for the host tests. Time is simulated: it advances only with delay() and with the
+// transfers on the fake Wire bus, see Wire.h
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+typedef uint8_t byte;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void noInterrupts();
+void interrupts();
+
+using std::min;
+using std::max;
+
+// simulated time in ns since the start of the test
+extern uint64_t simNanos;
+
+#endif
@@ -0,0 +1,113 @@
+// Simulated time and gauge for the host tests, see Arduino.h and Wire.h
+
+#include <Arduino.h>
+#include <Wire.h>
+
+uint64_t simNanos = 0;
+TwoWire Wire;
+
+uint32_t millis() { return (uint32_t) (simNanos / 1000000); }
+uint32_t micros() { return (uint32_t) (simNanos / 1000); }
+void delay(uint32_t ms) { simNanos += (uint64_t) ms * 1000000; }
+void noInterrupts() {}
+void interrupts() {}
+
+TwoWire::TwoWire()
+  : holdRefresh(false), nackNext(0), latencyMicros(0), onTransaction(NULL), _clock(100000), _pointer(0),
+    _txLength(0), _rxLength(0), _rxIndex(0), _nacked(false)
+{
+  memset(regs, 0, sizeof(regs));
+  resetCounters();
+}
+
+void TwoWire::resetCounters()
+{
+  bytes = 0;
+  transactions = 0;
+  busNanos = 0;
+}
+
+void TwoWire::clocks(uint32_t n)
+{
+  uint64_t nanos = (uint64_t) n * 1000000000ULL / _clock;
+  simNanos += nanos;
+  busNanos += nanos;
+}
+
+void TwoWire::beginTransmission(uint8_t)
+{
+  if (onTransaction != NULL)
+    onTransaction(*this);
+  _txLength = 0;
+  clocks(1 + 9); // START, address
+  bytes++;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if (_txLength >= sizeof(_tx))
+    return 0;
+  _tx[_txLength++] = data;
+  return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool stop)
+{
+  _nacked = nackNext > 0;
+  if (_nacked)
+    nackNext--;
+  else
+  {
+    clocks(9 * _txLength);
+    bytes += _txLength;
+  }
+  if (stop || _nacked)
+  {
+    clocks(1);
+    transactions++;
+    simNanos += (uint64_t) latencyMicros * 1000;
+    busNanos += (uint64_t) latencyMicros * 1000;
+  }
+  if (_nacked)
+    return 2;
+
+  if (_txLength > 0)
+    _pointer = _tx[0];
+  for (uint8_t i = 1; i + 1 < _txLength; i += 2)
+  {
+    uint16_t value = _tx[i] | (_tx[i + 1] << 8);
+    // the gauge clears Refresh once it loaded the model
+    if (_pointer == 0xDB && !holdRefresh)
+      value &= 0x7FFF;
+    regs[_pointer++] = value;
+  }
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t, uint8_t quantity)
+{
+  _rxLength = 0;
+  _rxIndex = 0;
+  if (_nacked)
+    return 0; // the write of the register address wasn't acknowledged, the read ends too
+
+  clocks(1 + 9 + 9 * quantity + 1); // repeated START, address, data, STOP
+  bytes += 1 + quantity;
+  transactions++;
+  simNanos += (uint64_t) latencyMicros * 1000;
+  busNanos += (uint64_t) latencyMicros * 1000;
+
+  uint8_t reg = _pointer;
+  for (uint8_t i = 0; i + 1 < quantity; i += 2, reg++)
+  {
+    _rx[i] = regs[reg] & 0xFF;
+    _rx[i + 1] = regs[reg] >> 8;
+  }
+  _rxLength = quantity;
+  return quantity;
+}
+
+int TwoWire::read()
+{
+  return _rxIndex < _rxLength ? _rx[_rxIndex++] : -1;
+}
@@ -0,0 +1,25 @@
+// Checks for the host tests, a failed check is printed and makes the test exit with 1
+
+#ifndef Test_h
+#define Test_h
+
+#include <stdio.h>
+
+static int testFailures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) \
+    { \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      testFailures++; \
+    } \
+  } while (0)
+
+static inline int testResult(const char* name)
+{
+  printf("%s: %s\n", name, testFailures == 0 ? "passed" : "FAILED");
+  return testFailures == 0 ? 0 : 1;
+}
+
+#endif
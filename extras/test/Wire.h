@@ -0,0 +1,56 @@
+// Fake Wire for the host tests: a simulated gauge register file behind a bus that counts bytes and
+// transactions and advances the simulated time like a real I2C bus at the set clock
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include <Arduino.h>
+
+class TwoWire
+{
+  public:
+    TwoWire();
+
+    void begin() {}
+    void setClock(uint32_t clockHz) { _clock = clockHz; }
+    uint32_t getClock() const { return _clock; }
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    uint8_t endTransmission(bool stop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    int available() const { return _rxLength - _rxIndex; }
+    int read();
+
+    // gauge registers, 16 bit little endian on the bus like the ModelGauge m5 gauges
+    uint16_t regs[256];
+    // the gauge doesn't clear ModelCfg.Refresh, e.g. to run the polling loops until they give up
+    bool holdRefresh;
+    // the next transactions aren't acknowledged, e.g. while the gauge wakes up
+    uint8_t nackNext;
+    // added to every transaction, for the worst case timing of a slow or stretched bus
+    uint32_t latencyMicros;
+    // called before every transaction, e.g. to update the measurement registers
+    void (*onTransaction)(TwoWire& wire);
+
+    // bus usage counted like MAX17055::CostModel: address bytes included, transactions end with STOP
+    uint32_t bytes;
+    uint32_t transactions;
+    uint64_t busNanos;
+    void resetCounters();
+
+  private:
+    uint32_t _clock;
+    uint8_t _pointer;
+    uint8_t _tx[64];
+    uint8_t _txLength;
+    uint8_t _rx[256];
+    uint8_t _rxLength;
+    uint8_t _rxIndex;
+    bool _nacked;
+
+    void clocks(uint32_t n);
+};
+
+extern TwoWire Wire;
+
+#endif
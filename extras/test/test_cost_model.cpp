@@ -0,0 +1,72 @@
+// MAX17055::CostModel against the bytes, transactions and bus time counted on the fake bus
+
+#include <Arduino-MAX17055_Driver.h>
+#include "Test.h"
+
+// the example of the CostModel documentation
+static_assert(MAX17055::CostModel::snapshot(400000).micros < 1200, "too slow");
+
+static const MAX17055::Config config = MAX17055::Config().capacity(3000).emptyVoltage(330, 380);
+
+// the model rounds every operation up to whole microseconds
+static void checkCost(const char* name, const MAX17055::BusCost& model)
+{
+  uint32_t measured = (uint32_t) (Wire.busNanos / 1000);
+  printf("%-16s model %4u bytes %3u transactions %6u us, bus %4u bytes %3u transactions %6u us\n", name,
+         model.bytes, model.transactions, model.micros, Wire.bytes, Wire.transactions, measured);
+  CHECK(Wire.bytes == model.bytes);
+  CHECK(Wire.transactions == model.transactions);
+  CHECK(measured <= model.micros && model.micros <= measured + model.transactions);
+}
+
+static void gaugeAfterPOR()
+{
+  memset(Wire.regs, 0, sizeof(Wire.regs));
+  Wire.regs[MAX17055::Status] = 0x0002;
+}
+
+static void run(uint32_t clockHz)
+{
+  printf("%u Hz\n", clockHz);
+  Wire.setClock(clockHz);
+  MAX17055 gauge(config);
+  bool por;
+
+  gaugeAfterPOR();
+  Wire.resetCounters();
+  CHECK(gauge.begin(por));
+  CHECK(por);
+  checkCost("initPOR", MAX17055::CostModel::initPOR(clockHz));
+
+  // warm boot and the settings check left to runJob()
+  Wire.resetCounters();
+  CHECK(gauge.beginInit(config));
+  uint32_t waitMs;
+  while (gauge.jobPending())
+    gauge.runJob(waitMs);
+  CHECK(!gauge.initPOR());
+  MAX17055::BusCost warm = MAX17055::CostModel::initWarm(clockHz);
+  MAX17055::BusCost verify = MAX17055::CostModel::initWarmVerify(clockHz);
+  checkCost("initWarm+Verify", MAX17055::BusCost{(uint16_t) (warm.bytes + verify.bytes),
+            (uint16_t) (warm.transactions + verify.transactions), warm.micros + verify.micros});
+
+  MAX17055::Snapshot snap;
+  Wire.resetCounters();
+  CHECK(gauge.readSnapshot(snap));
+  checkCost("snapshot", MAX17055::CostModel::snapshot(clockHz));
+
+  Wire.resetCounters();
+  gauge.restoreLearnedParameters(0x1234, 0x5678, 0x0BB8, 0x0010, 0x0BB8);
+  checkCost("restore", MAX17055::CostModel::restore(clockHz));
+
+  Wire.resetCounters();
+  gauge.getSOC();
+  checkCost("read", MAX17055::CostModel::read(clockHz));
+}
+
+int main()
+{
+  run(100000);
+  run(400000);
+  return testResult("test_cost_model");
+}
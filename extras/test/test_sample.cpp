@@ -0,0 +1,77 @@
+// sampleCurrent() against a gauge converting every 175.8ms: waits of the host jitter, Current often
+// repeats between conversions, and still no conversion may be sampled twice
+
+#include <Arduino-MAX17055_Driver.h>
+#include <stdlib.h>
+#include "Test.h"
+
+static const MAX17055::Config config = MAX17055::Config().capacity(3000);
+static const uint32_t phaseMicros = 12345;
+
+static bool constantCurrent = false;
+static uint32_t conversion = 0;  // of the last read
+static uint32_t conversionsRead = 0;
+
+static uint32_t conversionAt(uint32_t micros)
+{
+  return (micros - phaseMicros) / MAX17055::AdcPhase::periodMicros;
+}
+
+// the registers hold the result of the last conversion when a transaction starts
+static void adc(TwoWire& wire)
+{
+  uint32_t k = conversionAt(micros());
+  int16_t current = constantCurrent || k % 5 == 0 ? -1000 : -1000 + (int16_t) (k * 7919 % 13);
+  wire.regs[MAX17055::Current] = (uint16_t) current;
+  wire.regs[MAX17055::VCell] = 52000;
+  if (conversionsRead == 0 || k != conversion)
+    conversionsRead++;
+  conversion = k;
+}
+
+// a host that wakes up to 2ms late
+static void jitterWait(uint32_t ms)
+{
+  delay(ms);
+  simNanos += (uint64_t) (rand() % 2000) * 1000;
+}
+
+static void run(uint8_t n, uint16_t runs)
+{
+  uint16_t samples = 0;
+  uint16_t duplicates = 0;
+  for (uint16_t i = 0; i < runs; i++)
+  {
+    MAX17055 gauge(config);
+    Wire.regs[MAX17055::Status] = 0x0002;
+    bool por;
+    CHECK(gauge.begin(por, &Wire, jitterWait));
+
+    Wire.resetCounters();
+    conversionsRead = 0;
+    Wire.onTransaction = adc;
+    MAX17055::SampleStats stats = gauge.sampleCurrent(n);
+    Wire.onTransaction = NULL;
+
+    // every sample needs a conversion of its own
+    CHECK(stats.count == n);
+    CHECK(stats.count <= conversionsRead);
+    CHECK(Wire.transactions <= MAX17055::maxSampleReads(n));
+    samples += stats.count;
+    duplicates += stats.duplicates;
+    // the next run starts at another point of the ADC cycle
+    simNanos += (uint64_t) (rand() % 1000000) * 1000;
+  }
+  printf("%s, %u runs of sampleCurrent(%u): %u samples, %u duplicate reads discarded\n",
+         constantCurrent ? "constant current" : "repeating current", runs, n, samples, duplicates);
+}
+
+int main()
+{
+  srand(1);
+  simNanos = 200000000ULL;
+  run(20, 200);
+  constantCurrent = true;
+  run(20, 200);
+  return testResult("test_sample");
+}
@@ -0,0 +1,186 @@
+// MAX17055Scheduler over a simulated day: the MCU sleeps until nextDeadline() or an alert, every
+// wake-up has work to do and no read misses its deadline
+
+#include <Arduino-MAX17055_Scheduler.h>
+#include "Test.h"
+
+static const uint32_t dayMs = 24UL * 3600 * 1000;
+static const uint32_t alertsPerDay = 24;
+
+static MAX17055 gauge(MAX17055::Config().capacity(3000));
+static uint32_t controlRuns = 0;
+static uint32_t alertRuns = 0;
+
+static bool control(void*, uint32_t&)
+{
+  gauge.getInstantaneousCurrent();
+  controlRuns++;
+  return true;
+}
+
+static bool medium(void*, uint32_t&)
+{
+  MAX17055::Snapshot snap;
+  return gauge.readSnapshot(snap);
+}
+
+static bool health(void*, uint32_t&)
+{
+  MAX17055::LearnedParams params;
+  return gauge.getLearnedParameters(params);
+}
+
+static bool alert(void*, uint32_t&)
+{
+  if (gauge.getAlerts() != 0)
+    gauge.clearAlerts();
+  alertRuns++;
+  return true;
+}
+
+static void sleepUntilMs(uint32_t ms)
+{
+  if ((int32_t) (ms - millis()) > 0)
+    simNanos = (uint64_t) ms * 1000000;
+}
+
+static void simulateDay()
+{
+  const uint32_t clockHz = 400000;
+  Wire.setClock(clockHz);
+  MAX17055Scheduler scheduler;
+  int8_t ids[4];
+  ids[0] = scheduler.add(control, NULL, 1000, 50, MAX17055Scheduler::Control,
+                         MAX17055::CostModel::read(clockHz).micros, 0);
+  ids[1] = scheduler.add(medium, NULL, 10000, 1000, MAX17055Scheduler::Medium,
+                         MAX17055::CostModel::snapshot(clockHz).micros, 0);
+  ids[2] = scheduler.add(health, NULL, 3600000, 60000, MAX17055Scheduler::Health,
+                         MAX17055::CostModel::burstRead(5, clockHz).micros, 0);
+  ids[3] = scheduler.addAlert(alert, NULL, 100, MAX17055Scheduler::Control,
+                              MAX17055::CostModel::read(clockHz).micros + MAX17055::CostModel::write(clockHz).micros);
+
+  uint32_t wakeups = 0;
+  uint32_t idle = 0;
+  // alerts off the ms grid of the periodic reads, ALRT interrupts the sleep
+  uint64_t alertNanos = 1234567891ULL;
+  uint32_t alerts = 0;
+  while (millis() < dayMs)
+  {
+    uint32_t deadline = scheduler.nextDeadline();
+    if (alerts < alertsPerDay && alertNanos < (uint64_t) deadline * 1000000)
+    {
+      simNanos = alertNanos;
+      scheduler.notifyAlert();
+      alertNanos += 3600ULL * 1000000000;
+      alerts++;
+    }
+    else
+    {
+      sleepUntilMs(deadline);
+    }
+    if (millis() >= dayMs)
+      break;
+
+    wakeups++;
+    if (scheduler.poll(5000) == 0)
+      idle++;
+    // all due work was done, the next wake-up is in the future
+    CHECK((int32_t) (scheduler.nextDeadline() - millis()) > 0);
+  }
+
+  printf("%u wake-ups, %u without work, %u control reads, %u alerts handled\n", wakeups, idle, controlRuns, alertRuns);
+  CHECK(idle == 0);
+  CHECK(controlRuns == dayMs / 1000);
+  CHECK(alertRuns == alertsPerDay);
+  CHECK(wakeups == dayMs / 1000 + alertsPerDay);
+  for (uint8_t i = 0; i < 4; i++)
+    CHECK(scheduler.missed(ids[i]) == 0);
+}
+
+static void alertOnly()
+{
+  MAX17055Scheduler scheduler;
+  scheduler.addAlert(alert, NULL, 100, MAX17055Scheduler::Control, 100);
+  // nothing timed, sleep as long as millis() can express
+  CHECK((int32_t) (scheduler.nextDeadline() - millis()) == 0x7FFFFFFF);
+  scheduler.notifyAlert();
+  CHECK(scheduler.nextDeadline() == millis());
+  uint32_t runs = alertRuns;
+  CHECK(scheduler.poll(1000) == 1);
+  CHECK(alertRuns == runs + 1);
+}
+
+// takes longer than the period of its task
+static bool slow(void*, uint32_t&)
+{
+  delay(5);
+  return true;
+}
+
+static void overloaded()
+{
+  MAX17055Scheduler scheduler;
+  int8_t id = scheduler.add(slow, NULL, 1, 1, MAX17055Scheduler::Control, 5000, millis());
+  scheduler.add(slow, NULL, 2, 2, MAX17055Scheduler::Control, 5000, millis());
+  // returns although the tasks are ready again after every call
+  CHECK(scheduler.poll(1000) == 2);
+  CHECK(scheduler.poll(1000) == 2);
+  CHECK(scheduler.missed(id) > 0);
+}
+
+static uint32_t expensiveRuns = 0;
+static bool expensive(void*, uint32_t&)
+{
+  MAX17055::Snapshot snap;
+  gauge.readSnapshot(snap);
+  expensiveRuns++;
+  return true;
+}
+
+// a task that costs more than the whole budget of a poll still runs, and the MCU still sleeps
+static void overBudget()
+{
+  MAX17055Scheduler scheduler;
+  int8_t id = scheduler.add(expensive, NULL, 100, 100, MAX17055Scheduler::Medium, 10000, millis());
+  uint32_t end = millis() + 10000;
+  uint32_t polls = 0;
+  // without the first run of a poll the time wouldn't advance, stop after enough polls
+  while ((int32_t) (millis() - end) < 0 && polls < 1000)
+  {
+    sleepUntilMs(scheduler.nextDeadline());
+    scheduler.poll(5000);
+    polls++;
+    CHECK((int32_t) (scheduler.nextDeadline() - millis()) > 0);
+  }
+  printf("over budget: %u runs in %u polls\n", expensiveRuns, polls);
+  CHECK(expensiveRuns >= 99 && polls <= 101);
+  CHECK(scheduler.missed(id) == 0);
+}
+
+// a deadline passing while the task waits for the budget counts as missed once
+static void skippedLate()
+{
+  MAX17055Scheduler scheduler;
+  scheduler.add(slow, NULL, 0, 1, MAX17055Scheduler::Medium, 4000, millis());
+  int8_t id = scheduler.add(slow, NULL, 0, 1, MAX17055Scheduler::Medium, 4000, millis());
+  CHECK(scheduler.poll(5000) == 1);
+  CHECK(scheduler.missed(id) == 1);
+  CHECK(scheduler.poll(5000) == 1);
+  CHECK(scheduler.missed(id) == 1);
+  CHECK(scheduler.missed(-1) == 0);
+  CHECK(scheduler.missed(MAX17055_SCHEDULER_TASKS) == 0);
+}
+
+int main()
+{
+  Wire.regs[MAX17055::Status] = 0x0002;
+  bool por;
+  CHECK(gauge.begin(por));
+
+  simulateDay();
+  alertOnly();
+  overloaded();
+  overBudget();
+  skippedLate();
+  return testResult("test_scheduler");
+}
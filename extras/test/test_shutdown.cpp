@@ -0,0 +1,84 @@
+// shutdown() and wake(): hibernation is enabled again after the wake, also when the MCU reset in
+// between or the settings check configured the gauge again
+
+#include <Arduino-MAX17055_Driver.h>
+#include "Test.h"
+
+static const MAX17055::Config config = MAX17055::Config().capacity(3000).emptyVoltage(330, 380);
+static const uint16_t hibCfg = 0x8A05;
+
+static void configuredGauge(MAX17055& gauge)
+{
+  memset(Wire.regs, 0, sizeof(Wire.regs));
+  Wire.regs[MAX17055::Status] = 0x0002;
+  Wire.regs[MAX17055::HibCfg] = 0x870C;
+  bool por;
+  CHECK(gauge.begin(por));
+  Wire.regs[MAX17055::HibCfg] = hibCfg;
+}
+
+static void wakeSameMcu()
+{
+  MAX17055 gauge(config);
+  configuredGauge(gauge);
+  CHECK(gauge.shutdown());
+  CHECK(Wire.regs[MAX17055::HibCfg] == 0);
+  CHECK(Wire.regs[MAX17055::ConfigReg] & 0x0080);
+
+  bool por;
+  CHECK(gauge.wake(por));
+  CHECK(!por);
+  CHECK(Wire.regs[MAX17055::HibCfg] == hibCfg);
+}
+
+static void wakeAfterMcuReset()
+{
+  {
+    MAX17055 gauge(config);
+    configuredGauge(gauge);
+    CHECK(gauge.shutdown());
+  }
+  // the MCU reset during the storage, a new instance wakes the gauge
+  MAX17055 gauge(config);
+  bool por;
+  CHECK(gauge.wake(por));
+  CHECK(!por);
+  CHECK(Wire.regs[MAX17055::HibCfg] == 0x870C);
+}
+
+static void wakeWithSettingsLost()
+{
+  MAX17055 gauge(config);
+  configuredGauge(gauge);
+  CHECK(gauge.shutdown());
+  // the settings check finds VEmpty changed and configures the gauge like after a POR
+  Wire.regs[MAX17055::VEmpty] ^= 0x0080;
+  bool por;
+  CHECK(gauge.wake(por));
+  CHECK(Wire.regs[MAX17055::VEmpty] == config.vEmptyReg());
+  CHECK(Wire.regs[MAX17055::HibCfg] == hibCfg);
+}
+
+static void wakeAfterPOR()
+{
+  MAX17055 gauge(config);
+  configuredGauge(gauge);
+  CHECK(gauge.shutdown());
+  // the battery was disconnected, the gauge starts with its defaults
+  memset(Wire.regs, 0, sizeof(Wire.regs));
+  Wire.regs[MAX17055::Status] = 0x0002;
+  Wire.regs[MAX17055::HibCfg] = 0x870C;
+  bool por;
+  CHECK(gauge.wake(por));
+  CHECK(por);
+  CHECK(Wire.regs[MAX17055::HibCfg] == 0x870C);
+}
+
+int main()
+{
+  wakeSameMcu();
+  wakeAfterMcuReset();
+  wakeWithSettingsLost();
+  wakeAfterPOR();
+  return testResult("test_shutdown");
+}
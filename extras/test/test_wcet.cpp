@@ -0,0 +1,228 @@
+// Worst case execution time of the driver calls: every path runs on the fake bus with a latency
+// added to each transaction, and the observed time, transactions, runJob() calls and waits are
+// checked against the static bounds and the CostModel. Built with MAX17055_PROFILE, the profiling
+// hooks count the runJob() calls and the longest time of every operation
+
+#include <Arduino-MAX17055_Driver.h>
+#include "Test.h"
+
+static const uint32_t clockHz = 100000;
+static const uint32_t latencyMicros = 500; // clock stretching or a slow bus, per transaction
+static const MAX17055::Config config = MAX17055::Config().capacity(3000).emptyVoltage(330, 380);
+
+static const uint8_t opCount = 7;
+static const char* const opNames[opCount] = {"read", "write", "init", "runJob", "readSnapshot", "writeBatch", "restore"};
+static uint8_t opDepth[opCount];
+static uint64_t opStart[opCount];
+static uint32_t opMax[opCount];
+static uint32_t opCalls[opCount];
+
+void max17055ProfileBegin(uint8_t op, uint8_t)
+{
+  if (op >= opCount)
+    return;
+  opCalls[op]++;
+  if (opDepth[op]++ == 0)
+    opStart[op] = simNanos;
+}
+
+void max17055ProfileEnd(uint8_t op, uint8_t)
+{
+  if (op >= opCount || --opDepth[op] > 0)
+    return;
+  opMax[op] = max(opMax[op], (uint32_t) ((simNanos - opStart[op]) / 1000));
+}
+
+// wait function of the gauge, counts the time waited and lets the gauge get ready late
+static uint32_t waitedMs = 0;
+static uint32_t dnrClearsAfterMs = 0;
+static void simWait(uint32_t ms)
+{
+  delay(ms);
+  waitedMs += ms;
+  if (dnrClearsAfterMs > 0 && waitedMs >= dnrClearsAfterMs)
+    Wire.regs[MAX17055::FStat] &= ~1;
+}
+
+static MAX17055 gauge(config);
+
+static MAX17055::BusCost plus(const MAX17055::BusCost& a, const MAX17055::BusCost& b, uint16_t n = 1)
+{
+  return MAX17055::BusCost{(uint16_t) (a.bytes + n * b.bytes), (uint16_t) (a.transactions + n * b.transactions),
+                           a.micros + n * b.micros};
+}
+static const MAX17055::BusCost none = {0, 0, 0};
+
+struct Run
+{
+  const char* name;
+  uint64_t startNanos;
+  uint32_t jobCalls;
+};
+
+static Run start(const char* name)
+{
+  Wire.resetCounters();
+  waitedMs = 0;
+  Run run = {name, simNanos, opCalls[FuelGaugeCore::OpJob]};
+  return run;
+}
+
+// bound: bus usage without latency, maxJobCalls and maxWaitMs the static bounds of the loops
+static void finish(const Run& run, const MAX17055::BusCost& bound, uint16_t maxJobCalls, uint32_t maxWaitMs)
+{
+  uint32_t elapsed = (uint32_t) ((simNanos - run.startNanos) / 1000);
+  uint32_t jobCalls = opCalls[FuelGaugeCore::OpJob] - run.jobCalls;
+  uint32_t boundMicros = bound.micros + bound.transactions * latencyMicros + maxWaitMs * 1000;
+  printf("%-28s %8u us (bound %8u) %4u transactions (bound %4u) %4u runJob (bound %4u) %5u ms waited (bound %5u)\n",
+         run.name, elapsed, boundMicros, Wire.transactions, bound.transactions, jobCalls, maxJobCalls, waitedMs, maxWaitMs);
+  CHECK(elapsed <= boundMicros);
+  CHECK(Wire.transactions <= bound.transactions);
+  CHECK(jobCalls <= maxJobCalls);
+  CHECK(waitedMs <= maxWaitMs);
+}
+
+static void resetGauge(uint16_t status)
+{
+  memset(Wire.regs, 0, sizeof(Wire.regs));
+  Wire.regs[MAX17055::Status] = status;
+  Wire.holdRefresh = false;
+  dnrClearsAfterMs = 0;
+}
+
+static void initPaths()
+{
+  const uint16_t maxCalls = MAX17055::maxInitJobCalls();
+  const uint32_t maxWait = MAX17055::maxInitWaitMs();
+  const MAX17055::BusCost worst = MAX17055::CostModel::initWorst(clockHz);
+  bool por;
+
+  resetGauge(0x0002);
+  Run run = start("init, POR");
+  CHECK(gauge.init(config, por, &Wire, simWait));
+  finish(run, MAX17055::CostModel::initPOR(clockHz), maxCalls, maxWait);
+
+  run = start("init, warm boot");
+  CHECK(gauge.init(config, por, &Wire, simWait));
+  finish(run, plus(MAX17055::CostModel::initWarm(clockHz), MAX17055::CostModel::initWarmVerify(clockHz)), maxCalls, maxWait);
+
+  // FStat.DNR never clears
+  resetGauge(0x0002);
+  Wire.regs[MAX17055::FStat] = 1;
+  run = start("init, gauge never ready");
+  CHECK(!gauge.init(config, por, &Wire, simWait));
+  finish(run, worst, maxCalls, maxWait);
+
+  // the longest path: DNR clears at the last poll, then the model refresh never ends
+  resetGauge(0x0002);
+  Wire.regs[MAX17055::FStat] = 1;
+  dnrClearsAfterMs = maxWait / 2 - 10;
+  Wire.holdRefresh = true;
+  run = start("init, POR, refresh stuck");
+  CHECK(!gauge.init(config, por, &Wire, simWait));
+  finish(run, worst, maxCalls, maxWait);
+
+  // the same after a warm boot that finds VEmpty lost
+  resetGauge(0x0000);
+  Wire.regs[MAX17055::DesignCap] = config.designCapReg();
+  Wire.regs[MAX17055::FStat] = 1;
+  dnrClearsAfterMs = maxWait / 2 - 10;
+  Wire.holdRefresh = true;
+  run = start("init, warm, refresh stuck");
+  CHECK(!gauge.init(config, por, &Wire, simWait));
+  finish(run, worst, maxCalls, maxWait);
+
+  resetGauge(0x0002);
+  CHECK(gauge.init(config, por, &Wire, simWait));
+}
+
+static void restorePath()
+{
+  MAX17055::LearnedParams params;
+  Run run = start("learned parameters save");
+  CHECK(gauge.getLearnedParameters(params));
+  // the read plan merges neighbouring registers, at worst it reads each on its own
+  finish(run, plus(none, MAX17055::CostModel::read(clockHz), 5), 0, 0);
+
+  run = start("learned parameters restore");
+  CHECK(gauge.restoreLearnedParameters(params));
+  finish(run, MAX17055::CostModel::restore(clockHz), MAX17055::maxRestoreJobCalls(), 700);
+}
+
+static void alertPath()
+{
+  Wire.regs[MAX17055::Status] = MAX17055::alertVoltageLow | MAX17055::alertSOCLow;
+  Run run = start("alert handling");
+  CHECK(gauge.getAlerts() != 0);
+  gauge.clearAlerts();
+  CHECK(gauge.getAlerts() == 0);
+  finish(run, plus(MAX17055::CostModel::write(clockHz), MAX17055::CostModel::read(clockHz), 3), 0, 0);
+}
+
+static void snapshotPaths()
+{
+  MAX17055::Snapshot snap;
+  Wire.regs[MAX17055::RepSOC] = 50 * 256;
+  Wire.regs[MAX17055::VCell] = 48000;
+  Run run = start("readSnapshot");
+  CHECK(gauge.readSnapshot(snap));
+  finish(run, MAX17055::CostModel::snapshot(clockHz), 0, 0);
+
+  // both checked registers look like bus errors and are read again
+  gauge.setConsistencyCheck(true);
+  CHECK(gauge.readSnapshot(snap));
+  Wire.regs[MAX17055::RepSOC] = 0xFFFF;
+  Wire.regs[MAX17055::VCell] = 0;
+  run = start("readSnapshot, both re-read");
+  gauge.readSnapshot(snap);
+  finish(run, plus(MAX17055::CostModel::snapshot(clockHz), MAX17055::CostModel::read(clockHz), 2), 0, 0);
+  gauge.setConsistencyCheck(false);
+
+  MAX17055::SocSet socs;
+  run = start("readSocSet");
+  CHECK(gauge.readSocSet(socs));
+  finish(run, plus(none, MAX17055::CostModel::read(clockHz), 8), 0, 0);
+}
+
+static void samplePath()
+{
+  // the gauge stops updating, e.g. in shutdown: every read is a duplicate until the bound
+  const uint8_t n = 8;
+  Run run = start("sampleCurrent(8), no updates");
+  gauge.sampleCurrent(n);
+  // waits between the reads are at most one ADC cycle each
+  uint32_t maxWait = MAX17055::maxSampleReads(n) *
+                     ((MAX17055::AdcPhase::periodMicros + MAX17055::AdcPhase::guardMicros) / 1000 + 1);
+  finish(run, MAX17055::CostModel::sampleCurrent(n, clockHz), 0, maxWait);
+}
+
+static void wakePath()
+{
+  // a gauge that doesn't answer at all
+  Wire.nackNext = 255;
+  bool por;
+  Run run = start("wake, no answer");
+  CHECK(!gauge.wake(por));
+  // a probe is shorter than a register write
+  finish(run, plus(none, MAX17055::CostModel::write(clockHz), MAX17055::maxWakeProbes()), 0, MAX17055::maxWakeProbes());
+  Wire.nackNext = 0;
+}
+
+int main()
+{
+  Wire.setClock(clockHz);
+  Wire.latencyMicros = latencyMicros;
+  printf("%u Hz, %u us latency per transaction\n", clockHz, latencyMicros);
+
+  initPaths();
+  restorePath();
+  alertPath();
+  snapshotPaths();
+  samplePath();
+  wakePath();
+
+  printf("\nlongest operations\n");
+  for (uint8_t op = 0; op < opCount; op++)
+    printf("%-14s %8u us %6u calls\n", opNames[op], opMax[op], opCalls[op]);
+  return testResult("test_wcet");
+}